@@ -1,3 +1,13 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 /**
  * Prevent exceptions from leaving destructors.
@@ -166,4 +176,528 @@ class DatabaseManage4
  *
  * If class clients need to be able to react to exceptions thrown during an operation, the class should provide a
  * regular (i.e., non-destructor) function that performs the operation.
-*/
\ No newline at end of file
+*/
+
+
+
+/**
+ * DatabaseManage4 still closes on the caller's thread, in close() or in the destructor, so whoever drops the last
+ * reference waits for the teardown. Most connections shouldn't be closed at all: a pool leases them out and takes
+ * them back for the next client. The ones that must go (the client saw an error, or the pool is shutting down)
+ * are closed on a background reaper thread.
+ *
+ * The rules of this Item still hold:
+ *
+ * 1. Lease's destructor never throws. It only hands the connection back to the pool.
+ *
+ * 2. Failures of close() are caught on the reaper thread, and kept for clients who want to react to them:
+ *    takeCloseErrors() returns them through the regular (non-destructor) interface, as DatabaseManage4's close() did.
+ *
+ * 3. giveBack() is noexcept, so it must not allocate. A connection counts against the capacity until the reaper
+ *    has closed it, so idle plus to-close never exceeds the capacity, and both vectors are reserved to it up front.
+ *
+ * The pool is a template on the connection type, so the stub backend below can stand in for DatabaseConnection.
+ * Connections are moved in and out of the pool, so the type must be movable.
+*/
+template <typename Connection = DatabaseConnection>
+class ConnectionPool
+{
+    public:
+        class Lease
+        {
+            public:
+                Lease(Lease&& rhs) noexcept
+                    : m_pool { std::exchange(rhs.m_pool, nullptr) }, m_connection { std::move(rhs.m_connection) } {}
+
+                Lease& operator = (Lease&&) = delete;
+
+                ~Lease()
+                {
+                    if (m_pool)
+                    {
+                        m_pool->giveBack(std::move(m_connection), true);
+                    }
+                }
+
+                Connection& operator * () { return m_connection; }
+                Connection* operator -> () { return &m_connection; }
+
+                // The connection shouldn't be reused, have the reaper close it
+                void close() noexcept
+                {
+                    if (m_pool)
+                    {
+                        std::exchange(m_pool, nullptr)->giveBack(std::move(m_connection), false);
+                    }
+                }
+
+
+            private:
+                friend class ConnectionPool;
+
+                Lease(ConnectionPool* pool, Connection&& connection)
+                    : m_pool { pool }, m_connection { std::move(connection) } {}
+
+                ConnectionPool* m_pool;
+                Connection m_connection;
+        };
+
+
+        explicit ConnectionPool(std::size_t capacity)
+            : m_capacity { capacity }
+        {
+            m_idle.reserve(capacity);
+            m_toClose.reserve(capacity);
+
+            m_reaper = std::thread([this] { reaperLoop(); });
+        }
+
+        // Every Lease must be gone by now. Idle connections are closed by the reaper before it exits.
+        ~ConnectionPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                for (Connection& connection : m_idle)
+                {
+                    m_toClose.push_back(std::move(connection));
+                }
+
+                m_idle.clear();
+                m_stopping = true;
+            }
+
+            m_reapWork.notify_one();
+            m_reaper.join();
+        }
+
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator = (const ConnectionPool&) = delete;
+
+
+        // Reuse an idle connection, open a new one while under capacity, otherwise wait for a Lease to end
+        Lease acquire()
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            m_available.wait(guard, [this] { return !m_idle.empty() || m_open < m_capacity; });
+
+            if (!m_idle.empty())
+            {
+                Connection connection = std::move(m_idle.back());
+                m_idle.pop_back();
+
+                return Lease(this, std::move(connection));
+            }
+
+            ++m_open;
+            guard.unlock();
+
+            try
+            {
+                return Lease(this, Connection::create());
+            }
+            catch (...)
+            {
+                guard.lock();
+                --m_open;
+                m_available.notify_one();
+
+                throw;
+            }
+        }
+
+
+        std::vector<std::exception_ptr> takeCloseErrors()
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            return std::exchange(m_closeErrors, {});
+        }
+
+
+    private:
+        void giveBack(Connection&& connection, bool reusable) noexcept
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+
+                if (reusable)
+                {
+                    m_idle.push_back(std::move(connection));
+                }
+                else
+                {
+                    m_toClose.push_back(std::move(connection));     // Still counted in m_open until it is closed
+                    m_reapWork.notify_one();
+                }
+            }
+
+            m_available.notify_one();
+        }
+
+
+        void reaperLoop()
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+
+            while (true)
+            {
+                m_reapWork.wait(guard, [this] { return !m_toClose.empty() || m_stopping; });
+
+                if (m_toClose.empty())
+                {
+                    return;     // Stopping, and nothing left to close
+                }
+
+                Connection connection = std::move(m_toClose.back());
+                m_toClose.pop_back();
+
+                // Close outside the lock, this is the slow part the pool keeps off the callers' threads
+                guard.unlock();
+
+                std::exception_ptr error;
+
+                try
+                {
+                    connection.close();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                guard.lock();
+                --m_open;
+                m_available.notify_one();
+
+                if (error)
+                {
+                    m_closeErrors.push_back(error);
+                }
+            }
+        }
+
+
+        const std::size_t m_capacity;
+        std::size_t m_open = 0;     // Leased, idle, or waiting for the reaper to close them
+        bool m_stopping = false;
+
+        std::mutex m_mutex;
+        std::condition_variable m_available;
+        std::condition_variable m_reapWork;
+        std::vector<Connection> m_idle;
+        std::vector<Connection> m_toClose;
+        std::vector<std::exception_ptr> m_closeErrors;
+
+        std::thread m_reaper;
+};
+
+
+void doSomething(ConnectionPool<>& pool)
+{
+    auto db = pool.acquire();
+
+    // Use the DatabaseConnection object via db ...
+
+}   // db goes back to the pool, nothing is closed on this thread
+
+
+/**
+ * A stub backend makes the cost visible: opening and closing take a configurable time, and every tenth close
+ * fails. Each session opens a connection, does a little work, and closes it; with DatabaseManage4 the caller
+ * pays for both open and close every time, through the pool it pays for neither once the pool is warm.
+*/
+class StubConnection
+{
+    public:
+        static inline std::chrono::microseconds openLatency { 500 };
+        static inline std::chrono::microseconds closeLatency { 2000 };
+
+        static StubConnection create()
+        {
+            std::this_thread::sleep_for(openLatency);
+
+            return StubConnection();
+        }
+
+        void close()
+        {
+            std::this_thread::sleep_for(closeLatency);
+
+            if (++closeCount % 10 == 0)
+            {
+                throw std::runtime_error("close failed");
+            }
+        }
+
+
+    private:
+        static inline std::atomic<unsigned> closeCount { 0 };
+};
+
+
+struct SessionTimes
+{
+    std::chrono::nanoseconds direct;    // Open and close on the caller's thread, as DatabaseManage4 does
+    std::chrono::nanoseconds pooled;
+};
+
+SessionTimes benchmarkSessions(std::size_t sessions)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < sessions; ++i)
+    {
+        StubConnection connection = StubConnection::create();
+
+        try
+        {
+            connection.close();
+        }
+        catch (...)
+        {
+            // Swallowed, as in DatabaseManage4's destructor
+        }
+    }
+
+    auto direct = std::chrono::steady_clock::now() - start;
+
+    ConnectionPool<StubConnection> pool { 4 };
+    start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < sessions; ++i)
+    {
+        auto lease = pool.acquire();
+
+        if (i % 100 == 0)
+        {
+            lease.close();      // Now and then a connection goes bad and is retired
+        }
+    }
+
+    return { direct, std::chrono::steady_clock::now() - start };
+}
+
+
+
+/**
+ * Back to std::vector<Example>: if every element runs its close() from its own destructor, each element also
+ * needs its own try/catch, and a failure can only be swallowed or turned into a termination.
+ *
+ * BatchedCleanupVector keeps the elements' destructors trivial (or at least non-throwing) and holds the cleanup
+ * step separately. cleanup() walks the elements once, calls the cleanup function on each, and collects every
+ * failure instead of stopping at the first. When the pass is over, all failures are reported together in a
+ * single CleanupErrors exception, which carries the index and the exception of each failed element.
+ *
+ * Each element is cleaned up exactly once: a pass starts where the previous one stopped, so elements added after
+ * a cleanup() are left for the next one. As DatabaseManage4 does, the destructor runs a last pass over whatever
+ * the client didn't clean up, and swallows the report.
+*/
+class CleanupErrors : public std::runtime_error
+{
+    public:
+        using Failure = std::pair<std::size_t, std::exception_ptr>;     // Element index, what it threw
+
+        explicit CleanupErrors(std::vector<Failure> failures)
+            : std::runtime_error { std::to_string(failures.size()) + " element(s) failed to clean up" },
+              m_failures { std::move(failures) } {}
+
+        const std::vector<Failure>& failures() const noexcept
+        {
+            return m_failures;
+        }
+
+
+    private:
+        std::vector<Failure> m_failures;
+};
+
+
+template <typename T, typename Cleanup>
+class BatchedCleanupVector
+{
+    public:
+        explicit BatchedCleanupVector(Cleanup cleanup = Cleanup())
+            : m_cleanup { std::move(cleanup) } {}
+
+        ~BatchedCleanupVector()
+        {
+            if (m_cleanedUpTo < m_elements.size())
+            {
+                runCleanup();   // Failures are dropped, call cleanup() to see them
+            }
+        }
+
+        BatchedCleanupVector(const BatchedCleanupVector&) = delete;
+        BatchedCleanupVector& operator = (const BatchedCleanupVector&) = delete;
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args)
+        {
+            return m_elements.emplace_back(std::forward<Args>(args)...);
+        }
+
+        T& operator [] (std::size_t index) { return m_elements[index]; }
+        std::size_t size() const noexcept { return m_elements.size(); }
+
+        // Clean up every element not cleaned up yet, then throw one CleanupErrors if any of them failed
+        void cleanup()
+        {
+            std::vector<CleanupErrors::Failure> failures = runCleanup();
+
+            if (!failures.empty())
+            {
+                throw CleanupErrors(std::move(failures));
+            }
+        }
+
+
+    private:
+        std::vector<CleanupErrors::Failure> runCleanup() noexcept
+        {
+            std::vector<CleanupErrors::Failure> failures;
+
+            for (std::size_t i = m_cleanedUpTo; i < m_elements.size(); ++i)
+            {
+                try
+                {
+                    m_cleanup(m_elements[i]);
+                }
+                catch (...)
+                {
+                    try
+                    {
+                        failures.emplace_back(i, std::current_exception());
+                    }
+                    catch (...)
+                    {
+                        // Out of memory for the report itself, nothing better to do than drop this entry
+                    }
+                }
+            }
+
+            m_cleanedUpTo = m_elements.size();
+
+            return failures;
+        }
+
+        std::vector<T> m_elements;
+        Cleanup m_cleanup;
+        std::size_t m_cleanedUpTo = 0;      // Elements before this index have been cleaned up
+};
+
+
+struct CloseConnection
+{
+    void operator () (DatabaseConnection& connection) const
+    {
+        connection.close();
+    }
+};
+
+void closeAll()
+{
+    BatchedCleanupVector<DatabaseConnection, CloseConnection> connections;
+    connections.emplace_back(DatabaseConnection::create());
+    connections.emplace_back(DatabaseConnection::create());
+
+    try
+    {
+        connections.cleanup();
+    }
+    catch (const CleanupErrors& errors)
+    {
+        // One report for the whole batch: errors.failures() says which connections failed and why
+    }
+}
+
+
+/**
+ * Tearing down 10^6 elements: a std::vector of DatabaseManage4-style elements, each closing itself in its
+ * destructor inside its own try/catch, against one cleanup pass over the batch. The stub handle fails to
+ * close one time in a thousand.
+*/
+struct StubHandle
+{
+    std::size_t id;
+
+    void close()
+    {
+        if (id % 1000 == 0)
+        {
+            throw std::runtime_error("close failed");
+        }
+    }
+};
+
+struct SelfClosingHandle
+{
+    StubHandle handle;
+
+    ~SelfClosingHandle()
+    {
+        try
+        {
+            handle.close();
+        }
+        catch (...)
+        {
+            // Swallow, nothing else a destructor can do
+        }
+    }
+};
+
+struct CloseHandle
+{
+    void operator () (StubHandle& handle) const
+    {
+        handle.close();
+    }
+};
+
+
+struct TeardownTimes
+{
+    std::chrono::nanoseconds perElementDestructors;
+    std::chrono::nanoseconds batchedCleanup;
+    std::size_t reportedFailures;
+};
+
+TeardownTimes benchmarkTeardown(std::size_t count = 1'000'000)
+{
+    TeardownTimes times {};
+
+    {
+        std::vector<SelfClosingHandle> handles;
+        handles.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            handles.push_back({ { i } });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        handles.clear();
+        times.perElementDestructors = std::chrono::steady_clock::now() - start;
+    }
+
+    BatchedCleanupVector<StubHandle, CloseHandle> handles;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        handles.emplace_back(StubHandle { i });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        handles.cleanup();
+    }
+    catch (const CleanupErrors& errors)
+    {
+        times.reportedFailures = errors.failures().size();
+    }
+
+    times.batchedCleanup = std::chrono::steady_clock::now() - start;
+
+    return times;
+}
@@ -1,4 +1,17 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <linux/futex.h>
+#include <malloc.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 /**
  * Think carefully about copying behavior in resource-managing classes.
  *
@@ -6,23 +19,423 @@
 */
 
 // Suppose you are using a C API to manipulate mutual exclusion (mutex) object, offering lock() and unlock() function
-class Mutex { };
+class Mutex;
 
 void lock(Mutex *p_m);
 void unlock(Mutex *p_m);
 
+
+/**
+ * Behind that API, a Mutex can be a single 32-bit word and a Linux futex, the same building block std::mutex
+ * uses on Linux, with the policy under our control. The word is in one of three states:
+ * unlocked, locked, or locked with (possibly) sleeping waiters.
+ *
+ * 1. Uncontended, lock is one compare-and-swap and unlock is one exchange. No system call.
+ *
+ * 2. When the mutex is held, lock spins for a bounded number of rounds first, because critical sections are
+ *    usually short and sleeping costs two system calls and a context switch.
+ *
+ * 3. If spinning doesn't pay off, the waiter marks the word "contended" and sleeps in the kernel.
+ *    unlock only makes the wake-up system call when it finds that mark.
+ *
+ * This is the classic three-state mutex from Ulrich Drepper's "Futexes Are Tricky".
+*/
+class Mutex
+{
+    public:
+        Mutex() = default;
+        ~Mutex();       // Defined after LockProfiling, which has to forget the mutex
+
+        Mutex(const Mutex&) = delete;
+        Mutex& operator = (const Mutex&) = delete;
+
+        void lock() noexcept
+        {
+            std::uint32_t expected = unlocked;
+
+            if (!m_state.compare_exchange_strong(expected, locked, std::memory_order_acquire))
+            {
+                lockContended();
+            }
+        }
+
+        void unlock() noexcept
+        {
+            if (m_state.exchange(unlocked, std::memory_order_release) == contended)
+            {
+                syscall(SYS_futex, word(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+            }
+        }
+
+
+    private:
+        static constexpr std::uint32_t unlocked = 0;
+        static constexpr std::uint32_t locked = 1;
+        static constexpr std::uint32_t contended = 2;
+        static constexpr int spinLimit = 100;
+
+        static void cpuRelax() noexcept
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#endif
+        }
+
+        void lockContended() noexcept
+        {
+            // Spin while the owner is likely to release soon, but not if others are already asleep
+            for (int spin = 0; spin < spinLimit; ++spin)
+            {
+                std::uint32_t state = m_state.load(std::memory_order_relaxed);
+
+                if (state == contended)
+                {
+                    break;
+                }
+
+                if (state == unlocked && m_state.compare_exchange_weak(state, locked, std::memory_order_acquire))
+                {
+                    return;
+                }
+
+                cpuRelax();
+            }
+
+            // Taking the mutex in the contended state is conservative: unlock will make one wake-up call too many,
+            // which is harmless, instead of one too few, which would leave a waiter asleep forever
+            while (m_state.exchange(contended, std::memory_order_acquire) != unlocked)
+            {
+                syscall(SYS_futex, word(), FUTEX_WAIT_PRIVATE, contended, nullptr, nullptr, 0);
+            }
+        }
+
+        std::uint32_t* word() noexcept
+        {
+            return reinterpret_cast<std::uint32_t*>(&m_state);
+        }
+
+        std::atomic<std::uint32_t> m_state { unlocked };
+
+        static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "The futex is the atomic itself");
+};
+
+void lock(Mutex *p_m)
+{
+    p_m->lock();
+}
+
+void unlock(Mutex *p_m)
+{
+    p_m->unlock();
+}
+
+
+/**
+ * Lock acquires in its constructor and releases in its destructor, so it sees exactly how long each thread waited
+ * for a mutex and how long it then held it. Build with LOCK_PROFILING=1 and every Lock records, per mutex:
+ * the number of acquisitions, a histogram of wait times and a histogram of hold times.
+ *
+ * Each thread records into its own table, with plain stores to atomics nobody else writes, so profiling adds no
+ * contention of its own. lockContentionReport() sums the tables and ranks mutexes by total wait time.
+ * A thread's table stays registered after the thread exits, so its numbers remain in the report, and the next
+ * thread to start takes it over instead of allocating another: there are never more tables than threads alive
+ * at once. A Mutex clears its entries from every table when it is destroyed, so a new mutex at the same address
+ * starts from zero.
+ *
+ * Lock inherits the recording hooks from LockProfiler<lockProfilingEnabled>. With profiling off, that is an empty
+ * class with empty inline functions: the hooks compile to nothing and the empty base takes no space.
+*/
+#ifndef LOCK_PROFILING
+#define LOCK_PROFILING 0
+#endif
+
+inline constexpr bool lockProfilingEnabled = LOCK_PROFILING;
+
+namespace LockProfiling
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t histogramBuckets = 40;     // Bucket n counts durations in [2^(n-1), 2^n) nanoseconds
+    constexpr std::size_t mutexesPerThread = 64;     // Mutexes beyond this are counted in overflow only
+
+    struct Histogram
+    {
+        std::atomic<std::uint64_t> buckets[histogramBuckets] {};
+        std::atomic<std::uint64_t> totalNanoseconds { 0 };
+    };
+
+    struct MutexProfile
+    {
+        std::atomic<const Mutex*> mutex { nullptr };
+        std::atomic<std::uint64_t> acquisitions { 0 };
+        Histogram wait;
+        Histogram hold;
+    };
+
+    struct ThreadTable
+    {
+        MutexProfile profiles[mutexesPerThread];
+        std::atomic<std::uint64_t> overflow { 0 };
+        std::atomic<bool> inUse { true };
+        ThreadTable* next = nullptr;
+    };
+
+    inline std::atomic<ThreadTable*> allTables { nullptr };
+
+
+    // Only the owning thread writes, so a load and a store do the job of a read-modify-write
+    inline void add(std::atomic<std::uint64_t>& counter, std::uint64_t amount) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    inline void record(Histogram& histogram, Clock::duration duration) noexcept
+    {
+        auto nanoseconds = static_cast<std::uint64_t>(std::chrono::nanoseconds(duration).count());
+        std::size_t bucket = nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+
+        add(histogram.buckets[std::min(bucket, histogramBuckets - 1)], 1);
+        add(histogram.totalNanoseconds, nanoseconds);
+    }
+
+    // A table left by a thread that has exited, or a new one
+    inline ThreadTable* acquireTable()
+    {
+        for (ThreadTable* table = allTables.load(std::memory_order_acquire); table; table = table->next)
+        {
+            bool idle = false;
+
+            if (table->inUse.compare_exchange_strong(idle, true, std::memory_order_acquire))
+            {
+                return table;
+            }
+        }
+
+        ThreadTable* newTable = new ThreadTable;
+        newTable->next = allTables.load(std::memory_order_relaxed);
+        while (!allTables.compare_exchange_weak(newTable->next, newTable, std::memory_order_release)) { }
+
+        return newTable;
+    }
+
+    inline ThreadTable& threadTable()
+    {
+        struct Holder
+        {
+            ThreadTable* table = acquireTable();
+
+            ~Holder()
+            {
+                table->inUse.store(false, std::memory_order_release);
+            }
+        };
+
+        static thread_local Holder holder;
+
+        return *holder.table;
+    }
+
+    // Open addressing on the mutex address, the table never shrinks
+    inline MutexProfile* profileFor(ThreadTable& table, const Mutex* mutex) noexcept
+    {
+        std::size_t start = (reinterpret_cast<std::uintptr_t>(mutex) >> 4) % mutexesPerThread;
+
+        for (std::size_t probe = 0; probe < mutexesPerThread; ++probe)
+        {
+            MutexProfile& profile = table.profiles[(start + probe) % mutexesPerThread];
+            const Mutex* owner = profile.mutex.load(std::memory_order_acquire);    // forget() may have cleared it
+
+            if (owner == mutex)
+            {
+                return &profile;
+            }
+
+            if (owner == nullptr)
+            {
+                profile.mutex.store(mutex, std::memory_order_release);
+
+                return &profile;
+            }
+        }
+
+        add(table.overflow, 1);
+
+        return nullptr;
+    }
+
+    // A destroyed mutex is locked by nobody, so its entries have no writer left and can be cleared from here.
+    // An emptied slot can break a probe chain and give a later mutex a second entry in that table; the report
+    // merges entries by mutex, so that only costs a slot.
+    inline void forget(const Mutex* mutex) noexcept
+    {
+        for (ThreadTable* table = allTables.load(std::memory_order_acquire); table; table = table->next)
+        {
+            for (MutexProfile& profile : table->profiles)
+            {
+                if (profile.mutex.load(std::memory_order_relaxed) != mutex)
+                {
+                    continue;
+                }
+
+                profile.acquisitions.store(0, std::memory_order_relaxed);
+
+                for (Histogram* histogram : { &profile.wait, &profile.hold })
+                {
+                    for (std::atomic<std::uint64_t>& bucket : histogram->buckets)
+                    {
+                        bucket.store(0, std::memory_order_relaxed);
+                    }
+
+                    histogram->totalNanoseconds.store(0, std::memory_order_relaxed);
+                }
+
+                profile.mutex.store(nullptr, std::memory_order_release);    // Publishes the zeroed counters
+            }
+        }
+    }
+
+
+    struct MutexContention
+    {
+        const Mutex* mutex;
+        std::uint64_t acquisitions;
+        std::uint64_t waitNanoseconds;
+        std::uint64_t holdNanoseconds;
+        std::uint64_t waitHistogram[histogramBuckets];
+        std::uint64_t holdHistogram[histogramBuckets];
+    };
+
+    // The top mutexes by total time threads spent waiting for them
+    inline std::vector<MutexContention> lockContentionReport(std::size_t top)
+    {
+        std::vector<MutexContention> report;
+
+        auto merge = [](std::uint64_t (&into)[histogramBuckets], std::uint64_t& total, const Histogram& from)
+        {
+            for (std::size_t bucket = 0; bucket < histogramBuckets; ++bucket)
+            {
+                into[bucket] += from.buckets[bucket].load(std::memory_order_relaxed);
+            }
+
+            total += from.totalNanoseconds.load(std::memory_order_relaxed);
+        };
+
+        for (ThreadTable* table = allTables.load(std::memory_order_acquire); table; table = table->next)
+        {
+            for (const MutexProfile& profile : table->profiles)
+            {
+                const Mutex* mutex = profile.mutex.load(std::memory_order_acquire);
+
+                if (mutex == nullptr)
+                {
+                    continue;
+                }
+
+                auto entry = std::find_if(report.begin(), report.end(),
+                                          [mutex](const MutexContention& c) { return c.mutex == mutex; });
+
+                if (entry == report.end())
+                {
+                    entry = report.insert(report.end(), MutexContention { mutex, 0, 0, 0, {}, {} });
+                }
+
+                entry->acquisitions += profile.acquisitions.load(std::memory_order_relaxed);
+                merge(entry->waitHistogram, entry->waitNanoseconds, profile.wait);
+                merge(entry->holdHistogram, entry->holdNanoseconds, profile.hold);
+            }
+        }
+
+        std::sort(report.begin(), report.end(), [](const MutexContention& lhs, const MutexContention& rhs)
+        {
+            return lhs.waitNanoseconds > rhs.waitNanoseconds;
+        });
+
+        if (report.size() > top)
+        {
+            report.resize(top);
+        }
+
+        return report;
+    }
+}
+
+
+inline Mutex::~Mutex()
+{
+    if constexpr (lockProfilingEnabled)
+    {
+        LockProfiling::forget(this);
+    }
+}
+
+
+// Profiling off: nothing to store, nothing to do
+template <bool Enabled>
+class LockProfiler
+{
+    protected:
+        void beforeLock() noexcept {}
+        void afterLock(const Mutex*) noexcept {}
+        void beforeUnlock() noexcept {}
+};
+
+template <>
+class LockProfiler<true>
+{
+    protected:
+        // The thread's first Lock allocates its table here, before the mutex is taken, so nothing that can
+        // throw runs while the mutex is held
+        void beforeLock()
+        {
+            m_table = &LockProfiling::threadTable();
+            m_start = LockProfiling::Clock::now();
+        }
+
+        void afterLock(const Mutex* p_m) noexcept
+        {
+            m_acquired = LockProfiling::Clock::now();
+            m_profile = LockProfiling::profileFor(*m_table, p_m);
+
+            if (m_profile)
+            {
+                LockProfiling::add(m_profile->acquisitions, 1);
+                LockProfiling::record(m_profile->wait, m_acquired - m_start);
+            }
+        }
+
+        void beforeUnlock() noexcept
+        {
+            if (m_profile)
+            {
+                LockProfiling::record(m_profile->hold, LockProfiling::Clock::now() - m_acquired);
+            }
+        }
+
+
+    private:
+        LockProfiling::Clock::time_point m_start;
+        LockProfiling::Clock::time_point m_acquired;
+        LockProfiling::ThreadTable* m_table = nullptr;
+        LockProfiling::MutexProfile* m_profile = nullptr;
+};
+
 // To make sure you never forget to unlock a Mutex you've locked, you'd like to create a class to manage locks
-class Lock
+class Lock : private LockProfiler<lockProfilingEnabled>
 {
     public:
         explicit Lock(Mutex *p_m)
             : m_mutexPtr { p_m }
         {
+            beforeLock();
             lock(m_mutexPtr);   // Acquire resources
+            afterLock(m_mutexPtr);
         }
 
         ~Lock()
         {
+            beforeUnlock();
             unlock(m_mutexPtr);   // Release resources
         }
 
@@ -44,9 +457,15 @@ int main()
 }   // Automatically unlock mutex at end of block
 
 
-// Something weird will happen if someone try to do this
-Lock ml1(&m);
-Lock ml2(ml1);
+/**
+ * Something weird will happen if someone try to do this:
+ *
+ *     Lock ml1(&m);
+ *     Lock ml2(ml1);
+ *
+ * Now that Mutex is a real lock, it is not left as code: at namespace scope ml1 would lock m during static
+ * initialization, so main's Lock would wait for it forever, and ml1 and ml2 would both unlock m at exit.
+*/
 
 
 /**
@@ -98,6 +517,78 @@ class Lock3
 };
 
 
+/**
+ * Lock3 pays for its convenience: the std::shared_ptr allocates a control block on the heap for every lock,
+ * and every copy and destruction is an atomic read-modify-write on the count.
+ *
+ * A lock has to be released by the thread that acquired it, so all copies of a Lock3 live on one thread anyway.
+ * That makes reference linking enough: the copies of one lock form a circular doubly linked list through
+ * the copies themselves. Copying joins the list, destroying leaves it, and the copy that finds itself alone
+ * unlocks the mutex. No heap allocation, no atomics, the same semantics as Lock3.
+*/
+class Lock4
+{
+    public:
+        explicit Lock4(Mutex *p_m)
+            : m_mutexPtr { p_m }, m_previous { this }, m_next { this }
+        {
+            lock(m_mutexPtr);
+        }
+
+        Lock4(const Lock4& rhs) noexcept
+            : m_mutexPtr { rhs.m_mutexPtr }
+        {
+            join(rhs);
+        }
+
+        Lock4& operator = (const Lock4& rhs) noexcept
+        {
+            if (this != &rhs)
+            {
+                leave();
+                m_mutexPtr = rhs.m_mutexPtr;
+                join(rhs);
+            }
+
+            return *this;
+        }
+
+        ~Lock4()
+        {
+            leave();
+        }
+
+
+    private:
+        // Insert this right after rhs in rhs's list
+        void join(const Lock4& rhs) noexcept
+        {
+            m_previous = &rhs;
+            m_next = rhs.m_next;
+            m_next->m_previous = this;
+            rhs.m_next = this;
+        }
+
+        // The last copy out unlocks
+        void leave() noexcept
+        {
+            if (m_next == this)
+            {
+                unlock(m_mutexPtr);
+            }
+            else
+            {
+                m_previous->m_next = m_next;
+                m_next->m_previous = m_previous;
+            }
+        }
+
+        Mutex* m_mutexPtr;
+        mutable const Lock4* m_previous;    // Mutable: copying from a const Lock4 still links into its list
+        mutable const Lock4* m_next;
+};
+
+
 /**
  * 3. Copy the underlying resource.
  *
@@ -116,4 +607,125 @@ class Lock3
  * to the copying object.
  *
  * A "std::unique_ptr" can accomplish this, see https://en.cppreference.com/w/cpp/header/memory.
-*/
\ No newline at end of file
+*/
+
+
+
+/**
+ * Comparing Mutex with std::mutex: every thread takes the lock, bumps a shared counter and releases it,
+ * as fast as it can. Run it for 1, 2, 4, ..., 64 threads; the single-thread number is the uncontended cost.
+*/
+template <typename MutexType>
+double lockOperationsPerSecond(unsigned threadCount, std::size_t iterationsPerThread)
+{
+    MutexType mutex;
+    std::size_t counter = 0;
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&]
+        {
+            for (std::size_t i = 0; i < iterationsPerThread; ++i)
+            {
+                mutex.lock();
+                ++counter;
+                mutex.unlock();
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return counter / elapsed.count();
+}
+
+struct MutexThroughput
+{
+    unsigned threadCount;
+    double futexMutex;      // Lock operations per second
+    double standardMutex;
+};
+
+std::vector<MutexThroughput> benchmarkMutexes()
+{
+    std::vector<MutexThroughput> results;
+
+    for (unsigned threadCount = 1; threadCount <= 64; threadCount *= 2)
+    {
+        results.push_back({ threadCount,
+                            lockOperationsPerSecond<Mutex>(threadCount, 1'000'000 / threadCount),
+                            lockOperationsPerSecond<std::mutex>(threadCount, 1'000'000 / threadCount) });
+    }
+
+    return results;
+}
+
+
+
+/**
+ * Lock3 against Lock4: take the lock, make a copy, let both go, many times over on one thread.
+ *
+ * The heap a handle costs is read from glibc's own statistics rather than from a replacement global operator new:
+ * hold one handle on each of a batch of mutexes at once and divide the growth of the allocated bytes by the batch.
+ * Lock3 comes out at its shared_ptr control block plus malloc's chunk header, Lock4 at zero. The count is only
+ * meaningful against glibc's allocator; under a sanitizer that replaces malloc it reads zero for both.
+*/
+struct LockHandleCost
+{
+    std::chrono::nanoseconds perLock;
+    std::size_t heapBytesPerLock;
+};
+
+template <typename LockType>
+std::size_t heapBytesPerLock(std::size_t batch = 1024)
+{
+    std::unique_ptr<Mutex[]> mutexes(new Mutex[batch]);
+    std::vector<LockType> locks;
+    locks.reserve(batch);
+
+    std::size_t bytesBefore = mallinfo2().uordblks;
+
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+        locks.emplace_back(&mutexes[i]);
+    }
+
+    std::size_t bytesAfter = mallinfo2().uordblks;
+    locks.clear();  // Release every mutex before the array goes away
+
+    return (bytesAfter - bytesBefore) / batch;
+}
+
+template <typename LockType>
+LockHandleCost measureLockHandle(std::size_t iterations)
+{
+    Mutex mutex;
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < iterations; ++i)
+    {
+        LockType original(&mutex);
+        LockType copy(original);
+    }
+
+    return { (std::chrono::steady_clock::now() - start) / iterations, heapBytesPerLock<LockType>() };
+}
+
+struct LockHandleComparison
+{
+    LockHandleCost sharedPtrLock;
+    LockHandleCost linkedLock;
+};
+
+LockHandleComparison compareLockHandles(std::size_t iterations = 1'000'000)
+{
+    return { measureLockHandle<Lock3>(iterations), measureLockHandle<Lock4>(iterations) };
+}
@@ -1,3 +1,21 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 /**
  * Prefer non-member non-friend functions to member functions.
 */
@@ -89,4 +107,494 @@ namespace WebBrowserStuff
 namespace WebBrowserStuff
 {
     /*...*/
-}
\ No newline at end of file
+}
+
+
+// Header "web_browser_cache.h" - the storage clearCache clears
+namespace WebBrowserStuff
+{
+    /**
+     * An in-memory LRU cache of page bodies, bounded by a byte budget, safe to use from many threads.
+     *
+     * The cache is split into shards by a hash of the URL, each with its own mutex, LRU list and index, so threads
+     * working on different URLs rarely wait for each other. Each shard evicts its least recently used entries
+     * once it goes over its share of the budget.
+     *
+     * clear() doesn't walk anything: it bumps a generation number. Every entry remembers the generation it was
+     * stored in, and an entry from an older generation is treated as absent and dropped when a lookup finds it.
+     * Entries nobody asks for again age out of the LRU order like any other, so the memory comes back through
+     * normal eviction.
+    */
+    class BrowserCache
+    {
+        public:
+            explicit BrowserCache(std::size_t budgetBytes)
+                : m_shardBudget { budgetBytes / shardCount } {}
+
+            BrowserCache(const BrowserCache&) = delete;
+            BrowserCache& operator = (const BrowserCache&) = delete;
+
+            std::optional<std::string> get(std::string_view url)
+            {
+                Shard& shard = shardFor(url);
+                std::lock_guard<std::mutex> guard(shard.mutex);
+
+                auto found = shard.index.find(url);
+
+                if (found == shard.index.end())
+                {
+                    return std::nullopt;
+                }
+
+                if (found->second->generation != m_generation.load(std::memory_order_acquire))
+                {
+                    erase(shard, found);     // Cleared since it was stored
+
+                    return std::nullopt;
+                }
+
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+
+                return found->second->body;
+            }
+
+            void put(std::string url, std::string body)
+            {
+                Shard& shard = shardFor(url);
+                std::size_t bytes = entryBytes(url, body);
+                std::uint64_t generation = m_generation.load(std::memory_order_acquire);
+
+                std::lock_guard<std::mutex> guard(shard.mutex);
+
+                auto found = shard.index.find(url);
+
+                if (found != shard.index.end())
+                {
+                    erase(shard, found);
+                }
+
+                shard.entries.push_front(Entry { std::move(url), std::move(body), generation });
+                shard.index.emplace(shard.entries.front().url, shard.entries.begin());
+                shard.bytes += bytes;
+
+                while (shard.bytes > m_shardBudget && !shard.entries.empty())
+                {
+                    erase(shard, shard.index.find(shard.entries.back().url));
+                }
+            }
+
+            // O(1), whatever the size of the cache
+            void clear() noexcept
+            {
+                m_generation.fetch_add(1, std::memory_order_acq_rel);
+            }
+
+
+        private:
+            struct Entry
+            {
+                std::string url;
+                std::string body;
+                std::uint64_t generation;
+            };
+
+            using Entries = std::list<Entry>;      // Front is the most recently used
+
+            struct Shard
+            {
+                std::mutex mutex;
+                Entries entries;
+                std::unordered_map<std::string_view, Entries::iterator> index;  // Keys point into entries' urls
+                std::size_t bytes = 0;
+            };
+
+            static constexpr std::size_t shardCount = 16;
+
+            static std::size_t entryBytes(const std::string& url, const std::string& body) noexcept
+            {
+                return url.size() + body.size() + sizeof(Entry);
+            }
+
+            Shard& shardFor(std::string_view url)
+            {
+                return m_shards[std::hash<std::string_view>()(url) % shardCount];
+            }
+
+            static void erase(Shard& shard, std::unordered_map<std::string_view, Entries::iterator>::iterator found)
+            {
+                Entries::iterator entry = found->second;
+                shard.bytes -= entryBytes(entry->url, entry->body);
+                shard.index.erase(found);           // Before the entry, the key points into it
+                shard.entries.erase(entry);
+            }
+
+            const std::size_t m_shardBudget;
+            std::atomic<std::uint64_t> m_generation { 0 };
+            Shard m_shards[shardCount];
+    };
+
+
+    /**
+     * With millions of history entries or cookies, clearing a store means freeing millions of nodes, and whoever
+     * clears holds the store's mutex all that time, so every lookup on other threads stalls behind it.
+     *
+     * In asynchronous mode, clearing only swaps the full store with an empty one under the mutex, which is O(1),
+     * and hands the old store to an IncrementalReclaimer. Its background thread frees the old contents a batch
+     * at a time, in slices of bounded length with pauses in between, so it doesn't monopolize the allocator or
+     * the memory bus either. Lookups see an empty store immediately.
+    */
+    class IncrementalReclaimer
+    {
+        public:
+            IncrementalReclaimer()
+                : m_worker { [this] { run(); } } {}
+
+            // Finishes whatever is still queued, synchronously, before returning
+            ~IncrementalReclaimer()
+            {
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    m_stopping = true;
+                }
+
+                m_workAvailable.notify_one();
+                m_worker.join();
+            }
+
+            IncrementalReclaimer(const IncrementalReclaimer&) = delete;
+            IncrementalReclaimer& operator = (const IncrementalReclaimer&) = delete;
+
+            // Take ownership of a detached container and free its elements in the background
+            template <typename Container>
+            void retire(Container&& container)
+            {
+                auto job = std::make_unique<ContainerJob<std::decay_t<Container>>>(std::forward<Container>(container));
+
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    m_jobs.push_back(std::move(job));
+                }
+
+                m_workAvailable.notify_one();
+            }
+
+
+        private:
+            struct Job
+            {
+                virtual ~Job() = default;
+                virtual bool step(std::size_t batch) = 0;     // Free up to batch elements, true once empty
+            };
+
+            template <typename Container>
+            struct ContainerJob : Job
+            {
+                explicit ContainerJob(Container&& container)
+                    : m_container { std::move(container) } {}
+
+                bool step(std::size_t batch) override
+                {
+                    for (std::size_t i = 0; i < batch && !m_container.empty(); ++i)
+                    {
+                        m_container.erase(m_container.begin());
+                    }
+
+                    return m_container.empty();
+                }
+
+                Container m_container;
+            };
+
+            static constexpr std::size_t batchSize = 256;
+            static constexpr std::chrono::microseconds sliceLength { 500 };
+            static constexpr std::chrono::microseconds pauseLength { 500 };
+
+            void run()
+            {
+                std::unique_lock<std::mutex> guard(m_mutex);
+
+                while (true)
+                {
+                    m_workAvailable.wait(guard, [this] { return !m_jobs.empty() || m_stopping; });
+
+                    if (m_jobs.empty())
+                    {
+                        return;
+                    }
+
+                    std::unique_ptr<Job> job = std::move(m_jobs.front());
+                    m_jobs.pop_front();
+                    guard.unlock();
+
+                    // One slice at a time, stepping aside between slices, unless we are shutting down
+                    while (true)
+                    {
+                        auto sliceEnd = std::chrono::steady_clock::now() + sliceLength;
+                        bool done = false;
+
+                        while (!done && std::chrono::steady_clock::now() < sliceEnd)
+                        {
+                            done = job->step(batchSize);
+                        }
+
+                        if (done)
+                        {
+                            break;
+                        }
+
+                        guard.lock();
+                        bool stopping = m_stopping;
+                        guard.unlock();
+
+                        if (!stopping)
+                        {
+                            std::this_thread::sleep_for(pauseLength);
+                        }
+                    }
+
+                    job.reset();
+                    guard.lock();
+                }
+            }
+
+            std::mutex m_mutex;
+            std::condition_variable m_workAvailable;
+            std::deque<std::unique_ptr<Job>> m_jobs;
+            bool m_stopping = false;
+            std::thread m_worker;   // Declared last, so it starts after everything it uses is constructed
+    };
+
+
+    enum class ClearMode
+    {
+        Synchronous,    // Free everything before returning
+        Asynchronous    // Detach in O(1), free in the background
+    };
+
+
+    // A map guarded by its own mutex, that can be emptied either way
+    template <typename Value>
+    class GuardedStore
+    {
+        public:
+            using Map = std::unordered_map<std::string, Value>;
+
+            void put(std::string key, Value value)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_map.insert_or_assign(std::move(key), std::move(value));
+            }
+
+            std::optional<Value> get(const std::string& key) const
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                auto found = m_map.find(key);
+
+                return found == m_map.end() ? std::nullopt : std::optional<Value>(found->second);
+            }
+
+            void clear(ClearMode mode, IncrementalReclaimer& reclaimer)
+            {
+                if (mode == ClearMode::Synchronous)
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    m_map.clear();
+
+                    return;
+                }
+
+                Map detached;
+
+                {
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    detached.swap(m_map);
+                }
+
+                reclaimer.retire(std::move(detached));
+            }
+
+
+        private:
+            mutable std::mutex m_mutex;
+            Map m_map;
+    };
+
+
+    class WebBrowser4
+    {
+        public:
+            explicit WebBrowser4(std::size_t cacheBudgetBytes = 64 * 1024 * 1024)
+                : m_cache { cacheBudgetBytes } {}
+
+            BrowserCache& cache() noexcept
+            {
+                return m_cache;
+            }
+
+            GuardedStore<std::chrono::system_clock::time_point>& history() noexcept
+            {
+                return m_history;
+            }
+
+            GuardedStore<std::string>& cookies() noexcept
+            {
+                return m_cookies;
+            }
+
+            // Already O(1), see BrowserCache::clear
+            void clearCache() noexcept
+            {
+                m_cache.clear();
+            }
+
+            void clearHistory(ClearMode mode = ClearMode::Synchronous)
+            {
+                m_history.clear(mode, m_reclaimer);
+            }
+
+            void removeCookies(ClearMode mode = ClearMode::Synchronous)
+            {
+                m_cookies.clear(mode, m_reclaimer);
+            }
+
+            // WebBrowser's member, kept for callers that expect it; clearBrowser below does the same from outside
+            void clearEverything(ClearMode mode = ClearMode::Synchronous)
+            {
+                clearCache();
+                clearHistory(mode);
+                removeCookies(mode);
+            }
+
+
+        private:
+            IncrementalReclaimer m_reclaimer;   // Declared first, so it outlives the stores that feed it
+            BrowserCache m_cache;
+            GuardedStore<std::chrono::system_clock::time_point> m_history;     // URL -> last visit
+            GuardedStore<std::string> m_cookies;                               // Name -> value
+    };
+
+
+    // Still a non-member non-friend: it needs nothing beyond WebBrowser4's public interface
+    void clearBrowser(WebBrowser4& wb, ClearMode mode = ClearMode::Synchronous)
+    {
+        wb.clearCache();
+        wb.clearHistory(mode);
+        wb.removeCookies(mode);
+    }
+
+
+    /**
+     * Throughput under a mixed workload: each operation is a get (80%), a put (19%) or a clear (1%),
+     * on URLs drawn from a fixed set, from threadCount threads at once.
+    */
+    double cacheOperationsPerSecond(unsigned threadCount, std::size_t operationsPerThread)
+    {
+        BrowserCache cache { 16 * 1024 * 1024 };
+        std::vector<std::thread> threads;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&cache, operationsPerThread, seed = t + 1]() mutable
+            {
+                const std::string body(1024, 'x');
+
+                for (std::size_t i = 0; i < operationsPerThread; ++i)
+                {
+                    seed = seed * 1103515245u + 12345u;
+                    std::string url = "https://example.com/page/" + std::to_string((seed >> 8) % 50'000);
+                    unsigned operation = (seed >> 24) % 100;
+
+                    if (operation < 80)
+                    {
+                        cache.get(url);
+                    }
+                    else if (operation < 99)
+                    {
+                        cache.put(std::move(url), body);
+                    }
+                    else
+                    {
+                        cache.clear();
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return threadCount * operationsPerThread / elapsed.count();
+    }
+
+
+    /**
+     * Tail latency of cookie lookups while another thread clears a jar of cookieCount cookies.
+     * In synchronous mode the lookups wait for the whole jar to be freed; in asynchronous mode they only
+     * ever wait for a swap.
+    */
+    struct LookupLatency
+    {
+        std::chrono::nanoseconds p99;
+        std::chrono::nanoseconds p999;
+        std::chrono::nanoseconds max;
+    };
+
+    LookupLatency lookupLatencyDuringClear(ClearMode mode, std::size_t cookieCount, unsigned readerCount)
+    {
+        WebBrowser4 browser;
+
+        for (std::size_t i = 0; i < cookieCount; ++i)
+        {
+            browser.cookies().put("cookie" + std::to_string(i), "value");
+        }
+
+        std::atomic<bool> clearing { true };
+        std::vector<std::vector<std::chrono::nanoseconds>> samples(readerCount);
+        std::vector<std::thread> readers;
+
+        for (unsigned r = 0; r < readerCount; ++r)
+        {
+            readers.emplace_back([&, r]
+            {
+                for (std::size_t i = 0; clearing.load() || i < 10'000; ++i)
+                {
+                    std::string name = "cookie" + std::to_string(cookieCount ? i % cookieCount : i);     // Empty jar: all misses
+
+                    auto start = std::chrono::steady_clock::now();
+                    browser.cookies().get(name);
+                    samples[r].push_back(std::chrono::steady_clock::now() - start);
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        browser.removeCookies(mode);
+        clearing.store(false);
+
+        for (std::thread& reader : readers)
+        {
+            reader.join();
+        }
+
+        std::vector<std::chrono::nanoseconds> all;
+        for (const auto& readerSamples : samples)
+        {
+            all.insert(all.end(), readerSamples.begin(), readerSamples.end());
+        }
+
+        if (all.empty())
+        {
+            return {};  // No readers, no samples
+        }
+
+        std::sort(all.begin(), all.end());
+
+        return { all[all.size() * 99 / 100], all[all.size() * 999 / 1000], all.back() };
+    }
+}
@@ -9,15 +9,15 @@
 class Rational
 {
     public:
-        Rational(int denominator, int numerator = 1)    // Not explicit, allows implicit int-to-Rational conversion
+        constexpr Rational(int denominator, int numerator = 1)    // Not explicit, allows implicit int-to-Rational conversion
             : m_denominator { denominator }, m_numerator { numerator } {}
 
-        int denominator() const
+        constexpr int denominator() const
         {
             return m_denominator;
         }
 
-        int numerator() const
+        constexpr int numerator() const
         {
             return m_numerator;
         }
@@ -45,7 +45,7 @@ Rational result2 = 2 * oneEight;
  * The best approach is to make operator* a non-member function,
  * thus allowing compilers to perform implicit type conversions on all arguments.
 */
-const Rational operator * (const Rational& lhs, const Rational& rhs)
+constexpr const Rational operator * (const Rational& lhs, const Rational& rhs)
 {
     return Rational { lhs.numerator() * rhs.numerator(), lhs.denominator() * rhs.denominator() };
 }
@@ -1,5 +1,30 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <istream>
+#include <iterator>
+#include <list>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 /**
  * Strive for exception-safe code.
 */
@@ -116,6 +141,75 @@ void Menu2::changeBackgroundImage(std::istream& imgSrc)
 }
 
 
+/**
+ * imageChangeCount has a problem of its own. It is static, so every menu shares it, but each menu only holds its
+ * own mutex: two menus changing their backgrounds at the same time increment the same int unsynchronized.
+ * That is a data race. Making it a std::atomic<int> fixes the race, but then every change on every core
+ * fights over the same cache line. Menu and Menu2 keep the book's plain int; from Menu3 on the count is
+ * a ShardedCounter.
+ *
+ * ShardedCounter spreads the count over one cache line per shard. Each thread picks its shard once, on its first
+ * increment, from the core it is running on then; an increment is a relaxed fetch_add on that shard, so threads
+ * on different cores almost never touch each other's lines. read() adds up the shards; the result is
+ * exact once increments have stopped, and never more than the in-flight increments off while they haven't.
+ * Any hot statistic that is written far more often than read can use it the same way.
+*/
+class ShardedCounter
+{
+    public:
+        void add(std::uint64_t amount = 1) noexcept
+        {
+            m_shards[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+        }
+
+        std::uint64_t read() const noexcept
+        {
+            std::uint64_t total = 0;
+
+            for (const Shard& shard : m_shards)
+            {
+                total += shard.value.load(std::memory_order_relaxed);
+            }
+
+            return total;
+        }
+
+
+    private:
+        static constexpr std::size_t shardCount = 64;
+
+        struct alignas(64) Shard
+        {
+            std::atomic<std::uint64_t> value { 0 };
+        };
+
+        // Cached per thread, so sched_getcpu() runs once per thread rather than once per increment
+        static std::size_t shardIndex() noexcept
+        {
+            static thread_local std::size_t threadShard = pickShard();
+
+            return threadShard;
+        }
+
+        // The current CPU, when the system can tell (a thread migrating later only costs a little sharing)
+        static std::size_t pickShard() noexcept
+        {
+            int cpu = sched_getcpu();
+
+            if (cpu >= 0)
+            {
+                return static_cast<std::size_t>(cpu) % shardCount;
+            }
+
+            static std::atomic<std::size_t> nextShard { 0 };
+
+            return nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+        }
+
+        Shard m_shards[shardCount];
+};
+
+
 /**
  * General design strategy that offers strong guarantee - copy and swap.
  *
@@ -132,7 +226,7 @@ class MenuImplementation
     // The implementation of Menu3 ensures this class is private, therefore, public is fine
     public:
         std::shared_ptr<Image> backgroundImage;
-        static inline int imageChangeCount;
+        static inline ShardedCounter imageChangeCount;
 };
 
 class Menu3
@@ -150,7 +244,7 @@ void Menu3::changeBackgroundImage(std::istream& imgSrc)
     Lock ml(&mutex);
     std::shared_ptr<MenuImplementation> p_New(new MenuImplementation(*p_Impl));
     p_New->backgroundImage.reset(new Image(imgSrc));
-    ++p_New->imageChangeCount;
+    p_New->imageChangeCount.add();
     std::swap(p_Impl, p_New);
 }
 
@@ -164,3 +258,1084 @@ void Menu3::changeBackgroundImage(std::istream& imgSrc)
  *
  * A function can usually offer a guarantee no stronger than the weakest guarantee of the functions it calls.
 */
+
+
+/**
+ * Every Menu above takes the same exclusive Lock for everything, so code that only wants to look at the background
+ * image would queue up behind writers and behind each other. Reads vastly outnumber changes, so Menu4 lets readers
+ * skip the mutex entirely, with a read-copy-update (RCU) scheme:
+ *
+ * 1. The current MenuImplementation is published through an atomic pointer. A reader announces the epoch it
+ *    starts in, loads the pointer and uses the object. That is a few loads and stores, no loop, no lock:
+ *    readers are wait-free.
+ *
+ * 2. A writer does what Menu3 does: copy the implementation, change the copy, and only then swap it in,
+ *    so an exception leaves the menu untouched (the strong guarantee). Writers still serialize on a Lock.
+ *
+ * 3. The old implementation can't be deleted while a reader may still be looking at it. After the swap the writer
+ *    advances the epoch and waits until no reader is inside an older epoch; then nobody can hold the old pointer.
+ *
+ * Reader epochs live in a fixed table of slots, one per thread, claimed on a thread's first read.
+*/
+namespace Rcu
+{
+    constexpr std::size_t maxReaders = 256;
+
+    struct alignas(64) ReaderSlot      // One cache line each, so readers never share a line
+    {
+        std::atomic<std::uint64_t> epoch { 0 };     // 0 while the thread is outside any read
+        std::atomic<bool> claimed { false };
+    };
+
+    inline std::atomic<std::uint64_t> globalEpoch { 1 };
+    inline ReaderSlot readerSlots[maxReaders];
+
+    inline ReaderSlot& threadSlot()
+    {
+        struct SlotHolder
+        {
+            ReaderSlot* slot = nullptr;
+
+            SlotHolder()
+            {
+                while (slot == nullptr)
+                {
+                    for (ReaderSlot& candidate : readerSlots)
+                    {
+                        bool free = false;
+
+                        if (candidate.claimed.compare_exchange_strong(free, true))
+                        {
+                            slot = &candidate;
+                            break;
+                        }
+                    }
+
+                    if (slot == nullptr)
+                    {
+                        std::this_thread::yield();      // More than maxReaders threads, wait for one to exit
+                    }
+                }
+            }
+
+            ~SlotHolder()
+            {
+                slot->claimed.store(false);
+            }
+        };
+
+        static thread_local SlotHolder holder;
+
+        return *holder.slot;
+    }
+
+
+    // RAII (Item 13) for the read-side critical section
+    class ReadGuard
+    {
+        public:
+            // Guards nest: an inner guard keeps the outer one's epoch, which is older and so protects more
+            ReadGuard()
+                : m_slot { threadSlot() }, m_previousEpoch { m_slot.epoch.load(std::memory_order_relaxed) }
+            {
+                if (m_previousEpoch == 0)
+                {
+                    // seq_cst, so the writer can't miss this announcement once it has swapped the pointer
+                    m_slot.epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+                }
+            }
+
+            ~ReadGuard()
+            {
+                m_slot.epoch.store(m_previousEpoch, std::memory_order_release);    // 0 when leaving the outermost
+            }
+
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator = (const ReadGuard&) = delete;
+
+
+        private:
+            ReaderSlot& m_slot;
+            const std::uint64_t m_previousEpoch;
+    };
+
+
+    // Return once every reader that could have seen the old pointer has finished
+    inline void synchronize() noexcept
+    {
+        std::uint64_t newEpoch = globalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        for (ReaderSlot& slot : readerSlots)
+        {
+            while (true)
+            {
+                std::uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+
+                if (epoch == 0 || epoch >= newEpoch)
+                {
+                    break;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+
+class Menu4
+{
+    public:
+        Menu4()
+            : m_p_Impl { new MenuImplementation() } {}
+
+        ~Menu4()
+        {
+            delete m_p_Impl.load();
+        }
+
+        Menu4(const Menu4&) = delete;
+        Menu4& operator = (const Menu4&) = delete;
+
+        void changeBackgroundImage(std::istream& imgSrc);
+
+        // Run reader(const MenuImplementation&) against the current implementation, without taking the mutex
+        template <typename Reader>
+        decltype(auto) read(Reader&& reader) const
+        {
+            Rcu::ReadGuard guard;
+
+            return std::forward<Reader>(reader)(*m_p_Impl.load(std::memory_order_seq_cst));
+        }
+
+
+    private:
+        Mutex mutex;    // Serializes writers only
+        std::atomic<MenuImplementation*> m_p_Impl;
+        static inline ShardedCounter imageChangeCount;
+};
+
+void Menu4::changeBackgroundImage(std::istream& imgSrc)
+{
+    Lock ml(&mutex);
+
+    // Everything that can throw happens on the copy, as in Menu3
+    std::unique_ptr<MenuImplementation> p_New(new MenuImplementation(*m_p_Impl.load()));
+    p_New->backgroundImage.reset(new Image(imgSrc));
+
+    // From here on nothing throws
+    MenuImplementation* p_Old = m_p_Impl.exchange(p_New.release(), std::memory_order_seq_cst);
+    imageChangeCount.add();
+    Rcu::synchronize();
+    delete p_Old;
+}
+
+
+/**
+ * A read-heavy workload: each thread reads the background image 99 times for every change.
+ * MenuWithLockedReads is what a reader of Menu3 would have to do, take the same Lock as the writers.
+*/
+class MenuWithLockedReads
+{
+    public:
+        void changeBackgroundImage(std::istream& imgSrc)
+        {
+            Lock ml(&mutex);
+            std::shared_ptr<MenuImplementation> p_New(new MenuImplementation(*p_Impl));
+            p_New->backgroundImage.reset(new Image(imgSrc));
+            std::swap(p_Impl, p_New);
+        }
+
+        template <typename Reader>
+        decltype(auto) read(Reader&& reader)
+        {
+            Lock ml(&mutex);
+
+            return std::forward<Reader>(reader)(*p_Impl);
+        }
+
+
+    private:
+        Mutex mutex;
+        std::shared_ptr<MenuImplementation> p_Impl = std::make_shared<MenuImplementation>();
+};
+
+template <typename MenuType>
+double menuOperationsPerSecond(unsigned threadCount, std::size_t operationsPerThread)
+{
+    MenuType menu;
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&menu, operationsPerThread]
+        {
+            for (std::size_t i = 0; i < operationsPerThread; ++i)
+            {
+                if (i % 100 == 99)
+                {
+                    std::istringstream imgSrc("image bytes");
+                    menu.changeBackgroundImage(imgSrc);
+                }
+                else
+                {
+                    menu.read([](const MenuImplementation& impl) { return impl.backgroundImage != nullptr; });
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return threadCount * operationsPerThread / elapsed.count();
+}
+
+
+
+/**
+ * changeBackgroundImage builds its Image from a std::istream. The usual way to decode from a stream is to read all
+ * of it into a buffer first, so for a moment the process holds the encoded file, the decoded pixels, and whatever
+ * the stream buffers on top. For large backgrounds that is the peak memory of the whole operation.
+ *
+ * ImageDecoder is incremental: it accepts the encoded bytes in pieces of any size, parses the header as soon as it
+ * has it, allocates the pixel buffer once at its final size, and converts every later byte straight into it.
+ * That leaves two cheap ways to feed it:
+ *
+ * 1. Memory-map the file and hand over the mapping in one piece. The bytes are read from the page cache in place,
+ *    nothing is copied into the process first.
+ *
+ * 2. Read fixed-size chunks (from a file descriptor, or from a std::istream) into one small buffer and feed each.
+ *    Peak memory is the pixels plus a single chunk.
+ *
+ * The format here is binary PPM (P6): an ASCII header "P6 <width> <height> 255" followed by RGB triples.
+ * Pixels are stored as RGBA. The header comes from outside, so a dimension that is zero, not a plain number,
+ * too large for 32 bits, or that makes the image bigger than maxPixels is rejected before anything is allocated.
+*/
+class Image2
+{
+    public:
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::unique_ptr<std::uint8_t[]> pixels;     // width * height RGBA pixels
+};
+
+
+class ImageDecoder
+{
+    public:
+        static constexpr std::size_t maxPixels = std::size_t { 1 } << 28;     // 1 GiB of RGBA
+
+        // Feed the next piece of the encoded image, throws std::runtime_error on a malformed header
+        void feed(const char* data, std::size_t size)
+        {
+            std::size_t i = 0;
+
+            while (i < size && m_fieldsParsed < 4)
+            {
+                parseHeader(data[i++]);
+            }
+
+            for (; i < size && m_sourceOffset < m_sourceSize; ++i, ++m_sourceOffset)
+            {
+                std::size_t pixel = m_sourceOffset / 3;
+                std::size_t channel = m_sourceOffset % 3;
+
+                m_image.pixels[pixel * 4 + channel] = static_cast<std::uint8_t>(data[i]);
+
+                if (channel == 2)
+                {
+                    m_image.pixels[pixel * 4 + 3] = 255;
+                }
+            }
+        }
+
+        Image2 finish()
+        {
+            if (m_fieldsParsed < 4 || m_sourceOffset != m_sourceSize)
+            {
+                throw std::runtime_error("Truncated image");
+            }
+
+            return std::move(m_image);
+        }
+
+
+    private:
+        void parseHeader(char c)
+        {
+            if (m_inComment)
+            {
+                m_inComment = c != '\n';
+
+                return;
+            }
+
+            if (c == '#')
+            {
+                m_inComment = true;
+
+                return;
+            }
+
+            if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            {
+                m_field += c;
+
+                return;
+            }
+
+            if (m_field.empty())
+            {
+                return;     // Runs of whitespace between fields
+            }
+
+            switch (m_fieldsParsed++)
+            {
+                case 0:
+                    if (m_field != "P6")
+                    {
+                        throw std::runtime_error("Not a binary PPM image");
+                    }
+                    break;
+
+                case 1:
+                    m_image.width = parseDimension(m_field);
+                    break;
+
+                case 2:
+                    m_image.height = parseDimension(m_field);
+
+                    if (m_image.height > maxPixels / m_image.width)
+                    {
+                        throw std::runtime_error("Image too large");
+                    }
+                    break;
+
+                case 3:
+                    if (m_field != "255")
+                    {
+                        throw std::runtime_error("Only 8-bit channels are supported");
+                    }
+
+                    // The one and only allocation, at the final size, which can't overflow below maxPixels
+                    m_sourceSize = std::size_t { m_image.width } * m_image.height * 3;
+                    m_image.pixels.reset(new std::uint8_t[std::size_t { m_image.width } * m_image.height * 4]);
+                    break;
+            }
+
+            m_field.clear();
+        }
+
+        static std::uint32_t parseDimension(const std::string& field)
+        {
+            std::uint32_t value = 0;
+            auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value);
+
+            if (error != std::errc() || end != field.data() + field.size() || value == 0)
+            {
+                throw std::runtime_error("Invalid image dimension");
+            }
+
+            return value;
+        }
+
+        Image2 m_image;
+        std::string m_field;
+        int m_fieldsParsed = 0;
+        bool m_inComment = false;
+        std::size_t m_sourceOffset = 0;
+        std::size_t m_sourceSize = 0;
+};
+
+
+namespace ImageLoading
+{
+    constexpr std::size_t chunkSize = 64 * 1024;
+
+
+    // RAII (Item 13) for a file descriptor and for a mapping
+    class FileDescriptor
+    {
+        public:
+            explicit FileDescriptor(const char* path)
+                : m_fd { ::open(path, O_RDONLY) }
+            {
+                if (m_fd < 0)
+                {
+                    throw std::runtime_error("Cannot open image file");
+                }
+            }
+
+            ~FileDescriptor()
+            {
+                ::close(m_fd);
+            }
+
+            FileDescriptor(const FileDescriptor&) = delete;
+            FileDescriptor& operator = (const FileDescriptor&) = delete;
+
+            int get() const noexcept
+            {
+                return m_fd;
+            }
+
+
+        private:
+            int m_fd;
+    };
+
+    class Mapping
+    {
+        public:
+            Mapping(int fd, std::size_t size)
+                : m_data { ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) }, m_size { size }
+            {
+                if (m_data == MAP_FAILED)
+                {
+                    throw std::runtime_error("Cannot map image file");
+                }
+
+                ::madvise(m_data, m_size, MADV_SEQUENTIAL);     // Read ahead, drop pages behind
+            }
+
+            ~Mapping()
+            {
+                ::munmap(m_data, m_size);
+            }
+
+            Mapping(const Mapping&) = delete;
+            Mapping& operator = (const Mapping&) = delete;
+
+            const char* data() const noexcept
+            {
+                return static_cast<const char*>(m_data);
+            }
+
+
+        private:
+            void* m_data;
+            std::size_t m_size;
+    };
+
+
+    inline Image2 loadMapped(const char* path)
+    {
+        FileDescriptor file { path };
+
+        struct stat status {};
+        if (::fstat(file.get(), &status) != 0 || status.st_size == 0)
+        {
+            throw std::runtime_error("Cannot size image file");
+        }
+
+        Mapping mapping { file.get(), static_cast<std::size_t>(status.st_size) };
+
+        ImageDecoder decoder;
+        decoder.feed(mapping.data(), static_cast<std::size_t>(status.st_size));
+
+        return decoder.finish();
+    }
+
+
+    // readChunk(buffer, capacity) returns the number of bytes read, 0 at the end, and throws on a read error
+    template <typename ChunkReader>
+    Image2 loadChunked(ChunkReader readChunk)
+    {
+        std::unique_ptr<char[]> chunk { new char[chunkSize] };
+        ImageDecoder decoder;
+
+        while (std::size_t size = readChunk(chunk.get(), chunkSize))
+        {
+            decoder.feed(chunk.get(), size);
+        }
+
+        return decoder.finish();
+    }
+
+    inline Image2 loadStreaming(const char* path)
+    {
+        FileDescriptor file { path };
+
+        return loadChunked([&file](char* buffer, std::size_t capacity) -> std::size_t
+        {
+            while (true)
+            {
+                ssize_t size = ::read(file.get(), buffer, capacity);
+
+                if (size >= 0)
+                {
+                    return static_cast<std::size_t>(size);
+                }
+
+                if (errno != EINTR)     // Interrupted before reading anything: just try again
+                {
+                    throw std::runtime_error("Cannot read image file");
+                }
+            }
+        });
+    }
+
+    // Still a std::istream, as changeBackgroundImage takes, but in chunks instead of all at once
+    inline Image2 loadStreaming(std::istream& imgSrc)
+    {
+        return loadChunked([&imgSrc](char* buffer, std::size_t capacity) -> std::size_t
+        {
+            imgSrc.read(buffer, static_cast<std::streamsize>(capacity));
+
+            if (imgSrc.bad())
+            {
+                throw std::runtime_error("Cannot read image stream");
+            }
+
+            return static_cast<std::size_t>(imgSrc.gcount());
+        });
+    }
+
+    // The path being replaced: slurp the whole stream, then decode it
+    inline Image2 loadBuffered(std::istream& imgSrc)
+    {
+        std::vector<char> encoded { std::istreambuf_iterator<char>(imgSrc), std::istreambuf_iterator<char>() };
+
+        ImageDecoder decoder;
+        decoder.feed(encoded.data(), encoded.size());
+
+        return decoder.finish();
+    }
+}
+
+
+/**
+ * Compare the loaders on a large background. ru_maxrss only ever grows, so run each loader in a fresh process
+ * to read its peak memory: the buffered path peaks at roughly the file plus the pixels, the mapped and streaming
+ * paths at the pixels plus one chunk (the mapped pages are file cache, shared and reclaimable).
+*/
+struct DecodeResult
+{
+    std::chrono::nanoseconds elapsed;
+    long peakResidentKilobytes;
+};
+
+template <typename Load>
+DecodeResult benchmarkDecode(Load load)
+{
+    auto start = std::chrono::steady_clock::now();
+    Image2 image = load();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return { elapsed, usage.ru_maxrss };
+}
+
+// E.g. benchmarkDecode([] { return ImageLoading::loadMapped("background.ppm"); })
+//  and benchmarkDecode([] { std::ifstream in("background.ppm", std::ios::binary); return ImageLoading::loadBuffered(in); })
+
+
+
+/**
+ * SHA-256 (FIPS 180-4), fed in pieces of any size like ImageDecoder, so a stream can be hashed as it goes by.
+ * ImageCache below uses it as the identity of an image's content.
+*/
+class Sha256
+{
+    public:
+        using Digest = std::array<std::uint8_t, 32>;
+
+        void update(const char* data, std::size_t size) noexcept
+        {
+            m_length += size;
+
+            while (size > 0)
+            {
+                std::size_t take = std::min(size, sizeof(m_block) - m_blockSize);
+                std::memcpy(m_block + m_blockSize, data, take);
+                m_blockSize += take;
+                data += take;
+                size -= take;
+
+                if (m_blockSize == sizeof(m_block))
+                {
+                    compress();
+                    m_blockSize = 0;
+                }
+            }
+        }
+
+        Digest finish() noexcept
+        {
+            std::uint64_t bits = m_length * 8;
+
+            m_block[m_blockSize++] = 0x80;
+
+            if (m_blockSize > 56)
+            {
+                std::memset(m_block + m_blockSize, 0, sizeof(m_block) - m_blockSize);
+                compress();
+                m_blockSize = 0;
+            }
+
+            std::memset(m_block + m_blockSize, 0, 56 - m_blockSize);
+
+            for (int i = 0; i < 8; ++i)
+            {
+                m_block[63 - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+            }
+
+            compress();
+
+            Digest digest;
+
+            for (int i = 0; i < 32; ++i)
+            {
+                digest[i] = static_cast<std::uint8_t>(m_state[i / 4] >> (24 - 8 * (i % 4)));
+            }
+
+            return digest;
+        }
+
+
+    private:
+        static std::uint32_t rotate(std::uint32_t value, int bits) noexcept
+        {
+            return (value >> bits) | (value << (32 - bits));
+        }
+
+        void compress() noexcept
+        {
+            static constexpr std::uint32_t rounds[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+            };
+
+            std::uint32_t words[64];
+
+            for (int i = 0; i < 16; ++i)
+            {
+                words[i] = std::uint32_t { m_block[4 * i] } << 24 | std::uint32_t { m_block[4 * i + 1] } << 16 |
+                           std::uint32_t { m_block[4 * i + 2] } << 8 | std::uint32_t { m_block[4 * i + 3] };
+            }
+
+            for (int i = 16; i < 64; ++i)
+            {
+                std::uint32_t s0 = rotate(words[i - 15], 7) ^ rotate(words[i - 15], 18) ^ (words[i - 15] >> 3);
+                std::uint32_t s1 = rotate(words[i - 2], 17) ^ rotate(words[i - 2], 19) ^ (words[i - 2] >> 10);
+                words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+            }
+
+            std::uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+            std::uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+            for (int i = 0; i < 64; ++i)
+            {
+                std::uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) +
+                                   rounds[i] + words[i];
+                std::uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+
+            m_state[0] += a;
+            m_state[1] += b;
+            m_state[2] += c;
+            m_state[3] += d;
+            m_state[4] += e;
+            m_state[5] += f;
+            m_state[6] += g;
+            m_state[7] += h;
+        }
+
+        std::uint32_t m_state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        std::uint8_t m_block[64];
+        std::size_t m_blockSize = 0;
+        std::uint64_t m_length = 0;
+};
+
+
+/**
+ * Menus often share backgrounds, yet each Menu3 decodes its own copy. ImageCache decodes a given image once and
+ * hands every menu the same std::shared_ptr<const Image2>. The const matters: a shared image must never change,
+ * so a menu that wants another background swaps the pointer, exactly as before.
+ *
+ * The key is the content, not the file name: the SHA-256 digest of the encoded bytes. Two files with the same
+ * bytes share one decoded image, and a file rewritten in place gets a new entry. Nobody knows how to make two
+ * inputs with the same digest, so equal digests are taken as equal bytes and the cache keeps no copy of them.
+ *
+ * The digest is computed as the bytes go by, without buffering them:
+ *
+ * 1. A file is mapped, hashed in place, and decoded from the same mapping only on a miss.
+ *
+ * 2. A stream that can seek is hashed in chunks, then rewound and streamed through the decoder only on a miss.
+ *    One that can't is hashed and decoded in the same pass; a hit then saves keeping a second copy, not the decode.
+ *
+ * The cache holds at most budgetBytes of decoded pixels. Past that it drops the least recently used images;
+ * a menu still showing a dropped image keeps it alive through its shared_ptr, the cache just forgets it.
+ *
+ * Lookups take the cache's Mutex. Decoding happens outside it, so a slow decode never blocks hits. Two threads
+ * that miss on the same image at once both decode it, and the second one adopts the first one's result.
+*/
+class ImageCache
+{
+    public:
+        explicit ImageCache(std::size_t budgetBytes)
+            : m_budgetBytes { budgetBytes } {}
+
+        std::shared_ptr<const Image2> fromFile(const char* path)
+        {
+            ImageLoading::FileDescriptor file { path };
+
+            struct stat status {};
+            if (::fstat(file.get(), &status) != 0 || status.st_size == 0)
+            {
+                throw std::runtime_error("Cannot size image file");
+            }
+
+            std::size_t size = static_cast<std::size_t>(status.st_size);
+            ImageLoading::Mapping mapping { file.get(), size };
+
+            Sha256 hash;
+            hash.update(mapping.data(), size);
+            Sha256::Digest key = hash.finish();
+
+            if (std::shared_ptr<const Image2> cached = find(key))
+            {
+                return cached;
+            }
+
+            ImageDecoder decoder;
+            decoder.feed(mapping.data(), size);
+
+            return insert(key, decoder.finish());
+        }
+
+        std::shared_ptr<const Image2> fromStream(std::istream& imgSrc)
+        {
+            std::unique_ptr<char[]> chunk { new char[ImageLoading::chunkSize] };
+            std::istream::pos_type start = imgSrc.tellg();
+
+            if (start == std::istream::pos_type(-1))
+            {
+                return hashAndDecode(imgSrc, chunk.get());      // Not seekable, one pass for both
+            }
+
+            Sha256 hash;
+            forEachChunk(imgSrc, chunk.get(), [&hash](const char* data, std::size_t size) { hash.update(data, size); });
+            Sha256::Digest key = hash.finish();
+
+            if (std::shared_ptr<const Image2> cached = find(key))
+            {
+                return cached;
+            }
+
+            imgSrc.clear();
+
+            if (!imgSrc.seekg(start))
+            {
+                throw std::runtime_error("Cannot rewind image stream");
+            }
+
+            ImageDecoder decoder;
+            forEachChunk(imgSrc, chunk.get(), [&decoder](const char* data, std::size_t size) { decoder.feed(data, size); });
+
+            return insert(key, decoder.finish());
+        }
+
+
+    private:
+        struct KeyHash
+        {
+            std::size_t operator () (const Sha256::Digest& key) const noexcept
+            {
+                std::size_t hash;
+                std::memcpy(&hash, key.data(), sizeof(hash));     // Any bytes of a digest are as good as a hash
+
+                return hash;
+            }
+        };
+
+        struct Entry
+        {
+            Sha256::Digest key;
+            std::shared_ptr<const Image2> image;
+            std::size_t bytes;
+        };
+
+        using Entries = std::list<Entry>;      // Front is the most recently used
+
+        template <typename Consume>
+        static void forEachChunk(std::istream& imgSrc, char* chunk, Consume consume)
+        {
+            while (imgSrc.read(chunk, ImageLoading::chunkSize), imgSrc.gcount() > 0)
+            {
+                consume(chunk, static_cast<std::size_t>(imgSrc.gcount()));
+            }
+
+            if (imgSrc.bad())
+            {
+                throw std::runtime_error("Cannot read image stream");
+            }
+        }
+
+        std::shared_ptr<const Image2> hashAndDecode(std::istream& imgSrc, char* chunk)
+        {
+            Sha256 hash;
+            ImageDecoder decoder;
+
+            forEachChunk(imgSrc, chunk, [&](const char* data, std::size_t size)
+            {
+                hash.update(data, size);
+                decoder.feed(data, size);
+            });
+
+            Sha256::Digest key = hash.finish();
+            Image2 image = decoder.finish();
+
+            if (std::shared_ptr<const Image2> cached = find(key))
+            {
+                return cached;
+            }
+
+            return insert(key, std::move(image));
+        }
+
+        std::shared_ptr<const Image2> find(const Sha256::Digest& key)
+        {
+            Lock ml(&m_mutex);
+            auto found = m_index.find(key);
+
+            if (found == m_index.end())
+            {
+                return nullptr;
+            }
+
+            m_entries.splice(m_entries.begin(), m_entries, found->second);     // Now most recently used
+
+            return found->second->image;
+        }
+
+        std::shared_ptr<const Image2> insert(const Sha256::Digest& key, Image2&& image)
+        {
+            std::size_t bytes = std::size_t { image.width } * image.height * 4;
+            auto shared = std::make_shared<const Image2>(std::move(image));
+
+            Lock ml(&m_mutex);
+            auto found = m_index.find(key);
+
+            if (found != m_index.end())
+            {
+                return found->second->image;    // Another thread decoded it first
+            }
+
+            m_entries.push_front(Entry { key, shared, bytes });
+            m_index.emplace(key, m_entries.begin());
+            m_usedBytes += bytes;
+
+            while (m_usedBytes > m_budgetBytes && m_entries.size() > 1)
+            {
+                m_usedBytes -= m_entries.back().bytes;
+                m_index.erase(m_entries.back().key);
+                m_entries.pop_back();
+            }
+
+            return shared;
+        }
+
+        const std::size_t m_budgetBytes;
+        std::size_t m_usedBytes = 0;
+
+        Mutex m_mutex;
+        Entries m_entries;
+        std::unordered_map<Sha256::Digest, Entries::iterator, KeyHash> m_index;
+};
+
+
+// A local static, as Item 04 recommends, shared by every menu
+ImageCache& imageCache()
+{
+    static ImageCache cache { 256 * 1024 * 1024 };
+
+    return cache;
+}
+
+
+/**
+ * Menu5 is Menu3 with its background from the cache. The count goes up only once the new image is in hand,
+ * so a failed change (the decoder threw) doesn't count, and a cache hit counts like any other change.
+ * Every Menu5 shares the count, but each menu only holds its own mutex, so it is a ShardedCounter.
+*/
+class MenuImplementation2
+{
+    public:
+        std::shared_ptr<const Image2> backgroundImage;
+};
+
+class Menu5
+{
+    public:
+        void changeBackgroundImage(std::istream& imgSrc);
+
+        static std::uint64_t imageChanges() noexcept
+        {
+            return imageChangeCount.read();
+        }
+
+
+    private:
+        Mutex mutex;
+        std::shared_ptr<MenuImplementation2> p_Impl = std::make_shared<MenuImplementation2>();
+        static inline ShardedCounter imageChangeCount;
+};
+
+void Menu5::changeBackgroundImage(std::istream& imgSrc)
+{
+    Lock ml(&mutex);
+    std::shared_ptr<MenuImplementation2> p_New(new MenuImplementation2(*p_Impl));
+    p_New->backgroundImage = imageCache().fromStream(imgSrc);
+    std::swap(p_Impl, p_New);
+    imageChangeCount.add();
+}
+
+
+
+/**
+ * Copy-and-swap copies the whole MenuImplementation to change one member of it (new MenuImplementation(*p_Impl)),
+ * and the copy grows with every field the implementation gains.
+ *
+ * CowField<T> holds its value through a std::shared_ptr<const T>. Copying a CowField copies the pointer, not the
+ * value, so copying an implementation made of CowFields shares every member with the original; set() then gives
+ * the copy its own new value for the one member that changes. The values are const, so sharing is safe: nobody
+ * can modify a value another implementation still sees.
+ *
+ * Copying still touches every field's pointer (one reference count increment each). When an implementation
+ * grows to many fields, group related ones into a struct held by a single CowField: the copy then costs one
+ * increment per group, and a change rebuilds only the group it is in, the same path copying persistent
+ * data structures use.
+*/
+template <typename T>
+class CowField
+{
+    public:
+        CowField()
+            : m_value { std::make_shared<const T>() } {}
+
+        explicit CowField(T value)
+            : m_value { std::make_shared<const T>(std::move(value)) } {}
+
+        const T& get() const noexcept
+        {
+            return *m_value;
+        }
+
+        // May throw (allocation, T's constructor), but leaves *this untouched if it does
+        void set(T value)
+        {
+            m_value = std::make_shared<const T>(std::move(value));
+        }
+
+        void set(std::shared_ptr<const T> value) noexcept
+        {
+            m_value = std::move(value);
+        }
+
+
+    private:
+        std::shared_ptr<const T> m_value;
+};
+
+
+class MenuImplementation3
+{
+    public:
+        CowField<Image2> backgroundImage;
+        CowField<std::string> title;
+        CowField<std::vector<std::string>> items;
+};
+
+class Menu6
+{
+    public:
+        void changeBackgroundImage(std::istream& imgSrc);
+
+
+    private:
+        Mutex mutex;
+        std::shared_ptr<MenuImplementation3> p_Impl = std::make_shared<MenuImplementation3>();
+        static inline ShardedCounter imageChangeCount;
+};
+
+void Menu6::changeBackgroundImage(std::istream& imgSrc)
+{
+    Lock ml(&mutex);
+
+    // Shares title and items with the current implementation, only the background is new
+    std::shared_ptr<MenuImplementation3> p_New(new MenuImplementation3(*p_Impl));
+    p_New->backgroundImage.set(imageCache().fromStream(imgSrc));
+    std::swap(p_Impl, p_New);
+    imageChangeCount.add();
+}
+
+
+/**
+ * Update cost against implementation size: an implementation of fieldCount string fields, one of which changes
+ * per update. The deep-copy version copies every string, the CowField version copies every pointer.
+ * Run it for 1, 10, 25, 50 and 100 fields.
+*/
+struct UpdateCost
+{
+    std::chrono::nanoseconds deepCopy;
+    std::chrono::nanoseconds copyOnWrite;
+};
+
+UpdateCost benchmarkFieldUpdate(std::size_t fieldCount, std::size_t updates)
+{
+    const std::string value(64, 'x');      // Long enough to live on the heap, like most real members
+
+    auto timeUpdates = [updates, fieldCount](auto& p_Impl, auto update)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < updates; ++i)
+        {
+            auto p_New = std::make_shared<std::remove_reference_t<decltype(*p_Impl)>>(*p_Impl);
+            update(*p_New, i % fieldCount);
+            std::swap(p_Impl, p_New);
+        }
+
+        return (std::chrono::steady_clock::now() - start) / updates;
+    };
+
+    auto p_Deep = std::make_shared<std::vector<std::string>>(fieldCount, value);
+    auto deepCopy = timeUpdates(p_Deep, [&value](std::vector<std::string>& fields, std::size_t changed)
+    {
+        fields[changed] = value;
+    });
+
+    auto p_Cow = std::make_shared<std::vector<CowField<std::string>>>(fieldCount, CowField<std::string>(value));
+    auto copyOnWrite = timeUpdates(p_Cow, [&value](std::vector<CowField<std::string>>& fields, std::size_t changed)
+    {
+        fields[changed].set(value);
+    });
+
+    return { deepCopy, copyOnWrite };
+}
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <boost/scoped_array.hpp>
 /**
  * Factor parameter-independent code out of templates.
@@ -139,4 +146,398 @@ class SquareMatrix : private SquareMatrixBase<T>
  *
  * Bloat due to type parameters can be reduced by sharing implementations for instantiation types with
  * identical binary representations.
-*/
\ No newline at end of file
+*/
+
+
+
+/**
+ * Sharing invert through SquareMatrixBase is the right default, but for the small matrices that get inverted
+ * millions of times it throws away the one thing each SquareMatrix knows for free: its size. With Size a
+ * compile-time constant, loops have fixed trip counts the compiler can unroll completely, and whole rows fit
+ * in a few vector registers.
+ *
+ * SquareMatrix2 therefore picks a kernel with if constexpr. 2x2 and 3x3 use the closed-form adjugate; up to
+ * unrolledInversionLimit, Gauss-Jordan elimination runs on rows held as GCC vector-extension types, so every
+ * row update is a handful of SIMD instructions on whatever the target provides (SSE2 at least, on x86-64).
+ * Bigger matrices keep sharing SquareMatrixBase2::invert, so only the sizes that benefit pay the code size.
+ * The limit comes from benchmarkInversionCrossover below.
+*/
+inline constexpr std::size_t unrolledInversionLimit = 8;
+
+
+enum class InversionPath
+{
+    Automatic,      // Unrolled up to unrolledInversionLimit, shared beyond it
+    Unrolled,
+    Shared
+};
+
+
+namespace SmallMatrixKernels
+{
+    template <typename T>
+    void throwSingular()
+    {
+        throw std::domain_error("SquareMatrix: matrix is singular");
+    }
+
+
+    // Row-major data, inverted in place from the adjugate
+    template <typename T>
+    void invert2(T* a)
+    {
+        T determinant = a[0] * a[3] - a[1] * a[2];
+
+        if (determinant == 0)
+        {
+            throwSingular<T>();
+        }
+
+        T scale = 1 / determinant;
+        T inverse[4] = { a[3] * scale, -a[1] * scale, -a[2] * scale, a[0] * scale };
+
+        std::copy(inverse, inverse + 4, a);
+    }
+
+    template <typename T>
+    void invert3(T* a)
+    {
+        T cofactor0 = a[4] * a[8] - a[5] * a[7];
+        T cofactor1 = a[5] * a[6] - a[3] * a[8];
+        T cofactor2 = a[3] * a[7] - a[4] * a[6];
+        T determinant = a[0] * cofactor0 + a[1] * cofactor1 + a[2] * cofactor2;
+
+        if (determinant == 0)
+        {
+            throwSingular<T>();
+        }
+
+        T scale = 1 / determinant;
+        T inverse[9] = {
+            cofactor0 * scale, (a[2] * a[7] - a[1] * a[8]) * scale, (a[1] * a[5] - a[2] * a[4]) * scale,
+            cofactor1 * scale, (a[0] * a[8] - a[2] * a[6]) * scale, (a[2] * a[3] - a[0] * a[5]) * scale,
+            cofactor2 * scale, (a[1] * a[6] - a[0] * a[7]) * scale, (a[0] * a[4] - a[1] * a[3]) * scale
+        };
+
+        std::copy(inverse, inverse + 9, a);
+    }
+
+
+    constexpr std::size_t nextPowerOfTwo(std::size_t value)
+    {
+        std::size_t power = 1;
+
+        while (power < value)
+        {
+            power *= 2;
+        }
+
+        return power;
+    }
+
+    // A GCC vector of Width elements; the attribute only takes on a dependent type through a member typedef
+    template <typename T, std::size_t Width>
+    struct VectorOf
+    {
+        typedef T type __attribute__((vector_size(sizeof(T) * Width)));
+    };
+
+
+    /**
+     * Gauss-Jordan elimination with partial pivoting on [A | I]. Each augmented row is one vector of 2 * Size
+     * elements, padded to a power of two, so scaling a row or subtracting a multiple of the pivot row is a
+     * single vector expression, and with Size fixed every loop here unrolls.
+    */
+    template <typename T, std::size_t Size>
+    void invertUnrolled(T* a)
+    {
+        constexpr std::size_t width = nextPowerOfTwo(2 * Size);
+        using Row = typename VectorOf<T, width>::type;
+
+        Row rows[Size];
+
+#pragma GCC unroll 16
+        for (std::size_t i = 0; i < Size; ++i)
+        {
+            rows[i] = Row {};
+
+#pragma GCC unroll 16
+            for (std::size_t j = 0; j < Size; ++j)
+            {
+                rows[i][j] = a[i * Size + j];
+            }
+
+            rows[i][Size + i] = 1;
+        }
+
+#pragma GCC unroll 16
+        for (std::size_t k = 0; k < Size; ++k)
+        {
+            std::size_t pivot = k;
+
+            for (std::size_t i = k + 1; i < Size; ++i)
+            {
+                if (std::abs(rows[i][k]) > std::abs(rows[pivot][k]))
+                {
+                    pivot = i;
+                }
+            }
+
+            if (rows[pivot][k] == 0)
+            {
+                throwSingular<T>();
+            }
+
+            if (pivot != k)
+            {
+                Row swapped = rows[k];
+                rows[k] = rows[pivot];
+                rows[pivot] = swapped;
+            }
+
+            rows[k] *= 1 / rows[k][k];
+
+#pragma GCC unroll 16
+            for (std::size_t i = 0; i < Size; ++i)
+            {
+                if (i != k)
+                {
+                    rows[i] -= rows[i][k] * rows[k];
+                }
+            }
+        }
+
+#pragma GCC unroll 16
+        for (std::size_t i = 0; i < Size; ++i)
+        {
+#pragma GCC unroll 16
+            for (std::size_t j = 0; j < Size; ++j)
+            {
+                a[i * Size + j] = rows[i][Size + j];
+            }
+        }
+    }
+
+
+    template <typename T, std::size_t Size>
+    void invert(T* a)
+    {
+        if constexpr (Size == 1)
+        {
+            if (a[0] == 0)
+            {
+                throwSingular<T>();
+            }
+
+            a[0] = 1 / a[0];
+        }
+        else if constexpr (Size == 2)
+        {
+            invert2(a);
+        }
+        else if constexpr (Size == 3)
+        {
+            invert3(a);
+        }
+        else
+        {
+            invertUnrolled<T, Size>(a);
+        }
+    }
+}
+
+
+/**
+ * The shared path: the same elimination as invertUnrolled, with the size known only at run time.
+ * The augmented matrix lives in a per-thread scratch buffer, so repeated inversions don't allocate.
+*/
+template <typename T>
+class SquareMatrixBase2
+{
+    protected:
+        SquareMatrixBase2(std::size_t size, T* p_member)
+            : m_size { size }, m_p_data { p_member } {}
+
+        void invert(std::size_t size)
+        {
+            std::size_t width = 2 * size;
+            thread_local std::vector<T> augmented;
+
+            augmented.assign(size * width, T {});
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                std::copy(m_p_data + i * size, m_p_data + (i + 1) * size, augmented.begin() + i * width);
+                augmented[i * width + size + i] = 1;
+            }
+
+            for (std::size_t k = 0; k < size; ++k)
+            {
+                std::size_t pivot = k;
+
+                for (std::size_t i = k + 1; i < size; ++i)
+                {
+                    if (std::abs(augmented[i * width + k]) > std::abs(augmented[pivot * width + k]))
+                    {
+                        pivot = i;
+                    }
+                }
+
+                if (augmented[pivot * width + k] == 0)
+                {
+                    SmallMatrixKernels::throwSingular<T>();
+                }
+
+                if (pivot != k)
+                {
+                    std::swap_ranges(augmented.begin() + k * width, augmented.begin() + (k + 1) * width,
+                                     augmented.begin() + pivot * width);
+                }
+
+                T* pivotRow = augmented.data() + k * width;
+                T scale = 1 / pivotRow[k];
+
+                for (std::size_t j = 0; j < width; ++j)
+                {
+                    pivotRow[j] *= scale;
+                }
+
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    T* row = augmented.data() + i * width;
+                    T factor = row[k];
+
+                    if (i == k || factor == 0)
+                    {
+                        continue;
+                    }
+
+                    for (std::size_t j = 0; j < width; ++j)
+                    {
+                        row[j] -= factor * pivotRow[j];
+                    }
+                }
+            }
+
+            for (std::size_t i = 0; i < size; ++i)
+            {
+                std::copy(augmented.begin() + i * width + size, augmented.begin() + (i + 1) * width, m_p_data + i * size);
+            }
+        }
+
+        std::size_t size() const noexcept
+        {
+            return m_size;
+        }
+
+
+    private:
+        std::size_t m_size;     // Size of matrix
+        T* m_p_data;            // Pointer to matrix values
+};
+
+
+template <typename T, std::size_t Size>
+class SquareMatrix2 : private SquareMatrixBase2<T>
+{
+    static_assert(std::is_floating_point_v<T>, "SquareMatrix2 inverts floating-point matrices");
+
+    public:
+        SquareMatrix2()
+            : SquareMatrixBase2<T>(Size, m_data) {}
+
+        // The base points at m_data, so copies must point at their own
+        SquareMatrix2(const SquareMatrix2& rhs)
+            : SquareMatrixBase2<T>(Size, m_data)
+        {
+            std::copy(rhs.m_data, rhs.m_data + Size * Size, m_data);
+        }
+
+        SquareMatrix2& operator = (const SquareMatrix2& rhs)
+        {
+            std::copy(rhs.m_data, rhs.m_data + Size * Size, m_data);
+
+            return *this;
+        }
+
+        T& operator () (std::size_t row, std::size_t column) noexcept
+        {
+            return m_data[row * Size + column];
+        }
+
+        const T& operator () (std::size_t row, std::size_t column) const noexcept
+        {
+            return m_data[row * Size + column];
+        }
+
+        template <InversionPath Path = InversionPath::Automatic>
+        void invert()
+        {
+            if constexpr (Path == InversionPath::Unrolled ||
+                          (Path == InversionPath::Automatic && Size <= unrolledInversionLimit))
+            {
+                SmallMatrixKernels::invert<T, Size>(m_data);
+            }
+            else
+            {
+                SquareMatrixBase2<T>::invert(Size);
+            }
+        }
+
+
+    private:
+        T m_data[Size * Size] = {};
+};
+
+
+/**
+ * Nanoseconds per inversion along each path, for Size = 2..16. Each matrix is diagonally dominant, so it stays
+ * well conditioned while being inverted back and forth. The smallest Size where shared is at least as fast as
+ * unrolled is where unrolledInversionLimit belongs.
+*/
+struct InversionTiming
+{
+    std::size_t size;
+    double unrolledNanoseconds;
+    double sharedNanoseconds;
+};
+
+template <std::size_t Size, InversionPath Path>
+double nanosecondsPerInversion(int iterations)
+{
+    SquareMatrix2<double, Size> matrix;
+
+    for (std::size_t i = 0; i < Size; ++i)
+    {
+        for (std::size_t j = 0; j < Size; ++j)
+        {
+            matrix(i, j) = i == j ? Size + 1.0 : 1.0 / (1.0 + i + 2.0 * j);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int n = 0; n < iterations; ++n)
+    {
+        matrix.template invert<Path>();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    volatile double sink = matrix(0, 0);
+    (void)sink;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+template <std::size_t... Sizes>
+std::vector<InversionTiming> timeInversions(std::index_sequence<Sizes...>, int iterations)
+{
+    return { InversionTiming { Sizes + 2,
+                               nanosecondsPerInversion<Sizes + 2, InversionPath::Unrolled>(iterations),
+                               nanosecondsPerInversion<Sizes + 2, InversionPath::Shared>(iterations) }... };
+}
+
+std::vector<InversionTiming> benchmarkInversionCrossover(int iterations = 200000)
+{
+    return timeInversions(std::make_index_sequence<15>(), iterations);
+}
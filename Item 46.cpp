@@ -1,3 +1,16 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 /**
  * Define non-member functions inside templates when type conversions are desired.
  *
@@ -113,4 +126,1414 @@ template <typename T>
 const Rational3<T> multiply(const Rational3<T>& lhs, const Rational3<T>& rhs)
 {
     return Rational3<T>>(lhs.numerator() * rhs.numerator(), lhs.denominator() * rhs.denominator());
-}
\ No newline at end of file
+}
+
+
+/**
+ * None of the classes above ever reduce, so numerators and denominators only grow, and a handful of
+ * multiplications overflow int. Rational4 keeps every value in lowest terms with a positive denominator, so
+ * equal values have equal representations, and it throws RationalOverflow when a result doesn't fit in T
+ * instead of silently wrapping.
+ *
+ * Every operation computes in the next wider type (__int128 for std::int64_t), so intermediate products can't
+ * wrap, and only the reduced result is range-checked. The operands are cross-reduced before multiplying and
+ * the denominators' GCD is factored out before adding, so results come out in lowest terms without a GCD
+ * over the wide product, and all GCDs run on T-sized values.
+ *
+ * The operators are still friends defined inside the class template, so oneHalf * 2 keeps working.
+*/
+class RationalOverflow : public std::overflow_error
+{
+    public:
+        using std::overflow_error::overflow_error;
+};
+
+
+namespace RationalDetail
+{
+    template <typename T>
+    struct Wider;
+
+    template <> struct Wider<std::int8_t>  { using type = std::int16_t; };
+    template <> struct Wider<std::int16_t> { using type = std::int32_t; };
+    template <> struct Wider<std::int32_t> { using type = std::int64_t; };
+    template <> struct Wider<std::int64_t> { using type = __int128; };
+
+    template <typename T>
+    using WiderType = typename Wider<T>::type;
+
+
+    // std::make_unsigned only knows about __int128 in GNU mode
+    template <typename T>
+    struct MakeUnsigned : std::make_unsigned<T> {};
+
+    template <> struct MakeUnsigned<__int128> { using type = unsigned __int128; };
+
+
+    // Magnitude in the unsigned type, well defined even for the most negative value
+    template <typename T>
+    constexpr typename MakeUnsigned<T>::type magnitude(T value) noexcept
+    {
+        using Unsigned = typename MakeUnsigned<T>::type;
+
+        return value < 0 ? Unsigned(0) - static_cast<Unsigned>(value) : static_cast<Unsigned>(value);
+    }
+
+
+    template <typename Unsigned>
+    constexpr int countTrailingZeros(Unsigned value) noexcept
+    {
+        if constexpr (sizeof(Unsigned) > sizeof(unsigned long long))
+        {
+            auto low = static_cast<unsigned long long>(value);
+
+            return low != 0 ? __builtin_ctzll(low) : 64 + __builtin_ctzll(static_cast<unsigned long long>(value >> 64));
+        }
+        else
+        {
+            return __builtin_ctzll(value);
+        }
+    }
+
+
+    // Stein's binary GCD: shifts and subtractions instead of the divisions Euclid's algorithm needs
+    template <typename Unsigned>
+    constexpr Unsigned binaryGcd(Unsigned a, Unsigned b) noexcept
+    {
+        if (a == 0)
+        {
+            return b;
+        }
+
+        if (b == 0)
+        {
+            return a;
+        }
+
+        int shift = countTrailingZeros(a | b);
+        a >>= countTrailingZeros(a);
+
+        do
+        {
+            b >>= countTrailingZeros(b);
+
+            if (a > b)
+            {
+                Unsigned larger = a;     // Not std::swap, which isn't constexpr before C++20
+                a = b;
+                b = larger;
+            }
+
+            b -= a;
+        } while (b != 0);
+
+        return a << shift;
+    }
+
+
+    template <typename T>
+    constexpr T gcd(T a, T b) noexcept     // Fits in T as long as one of them isn't the most negative value
+    {
+        return static_cast<T>(binaryGcd(magnitude(a), magnitude(b)));
+    }
+}
+
+
+template <typename T>
+class Rational4
+{
+    static_assert(std::is_signed_v<T>, "Rational4 needs a signed integer type with a wider counterpart");
+
+    using Wide = RationalDetail::WiderType<T>;
+
+    public:
+        constexpr Rational4(const T& numerator = 0, const T& denominator = 1)
+        {
+            if (denominator == 0)
+            {
+                throw std::domain_error("Rational4: zero denominator");
+            }
+
+            Wide divisor = static_cast<Wide>(RationalDetail::binaryGcd(RationalDetail::magnitude(numerator),
+                                                                       RationalDetail::magnitude(denominator)));
+            Wide sign = denominator < 0 ? -1 : 1;
+
+            assign(sign * numerator / divisor, sign * denominator / divisor);
+        }
+
+        // For values known to be in lowest terms with a positive denominator, such as a RationalVector's
+        // elements: skips the GCD the constructor would compute only to find 1
+        constexpr static Rational4 fromLowestTerms(const T& numerator, const T& denominator)
+        {
+            return fromReduced(numerator, denominator);
+        }
+
+        constexpr T numerator() const noexcept
+        {
+            return m_numerator;
+        }
+
+        constexpr T denominator() const noexcept
+        {
+            return m_denominator;
+        }
+
+        friend constexpr const Rational4 operator * (const Rational4& lhs, const Rational4& rhs)
+        {
+            return product(lhs.m_numerator, lhs.m_denominator, rhs.m_numerator, rhs.m_denominator);
+        }
+
+        friend constexpr const Rational4 operator / (const Rational4& lhs, const Rational4& rhs)
+        {
+            if (rhs.m_numerator == 0)
+            {
+                throw std::domain_error("Rational4: division by zero");
+            }
+
+            return product(lhs.m_numerator, lhs.m_denominator, rhs.m_denominator, rhs.m_numerator);
+        }
+
+        friend constexpr const Rational4 operator + (const Rational4& lhs, const Rational4& rhs)
+        {
+            return sum(lhs, rhs.m_numerator, rhs.m_denominator);
+        }
+
+        friend constexpr const Rational4 operator - (const Rational4& lhs, const Rational4& rhs)
+        {
+            return sum(lhs, -static_cast<Wide>(rhs.m_numerator), rhs.m_denominator);
+        }
+
+        friend constexpr const Rational4 operator - (const Rational4& value)
+        {
+            return fromReduced(-static_cast<Wide>(value.m_numerator), value.m_denominator);
+        }
+
+        // Lowest terms make the representation unique, so equality is memberwise
+        friend constexpr bool operator == (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return lhs.m_numerator == rhs.m_numerator && lhs.m_denominator == rhs.m_denominator;
+        }
+
+        friend constexpr bool operator != (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+        friend constexpr bool operator < (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return static_cast<Wide>(lhs.m_numerator) * rhs.m_denominator <
+                   static_cast<Wide>(rhs.m_numerator) * lhs.m_denominator;
+        }
+
+        friend constexpr bool operator > (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return rhs < lhs;
+        }
+
+        friend constexpr bool operator <= (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return !(rhs < lhs);
+        }
+
+        friend constexpr bool operator >= (const Rational4& lhs, const Rational4& rhs) noexcept
+        {
+            return !(lhs < rhs);
+        }
+
+
+    private:
+        T m_numerator = 0;
+        T m_denominator = 1;
+
+        struct Reduced {};
+
+        constexpr Rational4(Reduced, Wide numerator, Wide denominator)
+        {
+            assign(numerator, denominator);
+        }
+
+        constexpr void assign(Wide numerator, Wide denominator)
+        {
+            if (numerator < std::numeric_limits<T>::min() || numerator > std::numeric_limits<T>::max() ||
+                denominator > std::numeric_limits<T>::max())
+            {
+                throw RationalOverflow("Rational4: result does not fit the underlying integer type");
+            }
+
+            m_numerator = static_cast<T>(numerator);
+            m_denominator = static_cast<T>(denominator);
+        }
+
+        constexpr static Rational4 fromReduced(Wide numerator, Wide denominator)
+        {
+            return Rational4(Reduced {}, numerator, denominator);
+        }
+
+        // (a / b) * (c / d), where a / b and d / c are in lowest terms, but b and d may be negative
+        constexpr static Rational4 product(T a, T b, T c, T d)
+        {
+            if (a == 0 || c == 0)
+            {
+                return Rational4 {};
+            }
+
+            T left = RationalDetail::gcd(a, d);
+            T right = RationalDetail::gcd(c, b);
+
+            Wide numerator = static_cast<Wide>(a / left) * (c / right);
+            Wide denominator = static_cast<Wide>(b / right) * (d / left);
+
+            if (denominator < 0)
+            {
+                numerator = -numerator;
+                denominator = -denominator;
+            }
+
+            return fromReduced(numerator, denominator);
+        }
+
+        // lhs + c / d, where d > 0 and c is widened so that subtraction can negate the most negative T
+        constexpr static Rational4 sum(const Rational4& lhs, Wide c, T d)
+        {
+            T b = lhs.m_denominator;
+            T divisor = RationalDetail::gcd(b, d);
+
+            if (divisor == 1)
+            {
+                return fromReduced(static_cast<Wide>(lhs.m_numerator) * d + c * b, static_cast<Wide>(b) * d);
+            }
+
+            Wide numerator = static_cast<Wide>(lhs.m_numerator) * (d / divisor) + c * (b / divisor);
+
+            if (numerator == 0)
+            {
+                return Rational4 {};
+            }
+
+            // Any common factor of the result has to divide the denominators' GCD
+            T common = RationalDetail::gcd(static_cast<T>(numerator % divisor), divisor);
+
+            return fromReduced(numerator / common, static_cast<Wide>(b / divisor) * (d / common));
+        }
+};
+
+
+Rational4<std::int64_t> oneThird { 1, 3 };
+Rational4<std::int64_t> result3 = oneThird * 3;      // 1/1 rather than 3/3, mixed mode still works
+
+
+/**
+ * Long chains, each in lowest terms at every step: the product of k / (k + 1) for k = 1..length telescopes
+ * to 1 / (length + 1), and the sum of 1 / (k * (k + 1)) telescopes to length / (length + 1).
+ * Without reduction the product would overflow std::int64_t after 20 factors.
+*/
+struct ChainTiming
+{
+    double nanosecondsPerMultiply;
+    double nanosecondsPerAdd;
+    bool correct;
+};
+
+template <typename T>
+ChainTiming benchmarkRationalChains(T length, int repetitions = 100)
+{
+    using Clock = std::chrono::steady_clock;
+
+    bool correct = true;
+    auto start = Clock::now();
+
+    for (int r = 0; r < repetitions; ++r)
+    {
+        Rational4<T> product = 1;
+
+        for (T k = 1; k <= length; ++k)
+        {
+            product = product * Rational4<T>(k, k + 1);
+        }
+
+        correct = correct && product == Rational4<T>(1, length + 1);
+    }
+
+    auto middle = Clock::now();
+
+    for (int r = 0; r < repetitions; ++r)
+    {
+        Rational4<T> sum = 0;
+
+        for (T k = 1; k <= length; ++k)
+        {
+            sum = sum + Rational4<T>(1, k * (k + 1));
+        }
+
+        correct = correct && sum == Rational4<T>(length, length + 1);
+    }
+
+    auto end = Clock::now();
+    double operations = static_cast<double>(length) * repetitions;
+
+    return { std::chrono::duration<double, std::nano>(middle - start).count() / operations,
+             std::chrono::duration<double, std::nano>(end - middle).count() / operations,
+             correct };
+}
+
+
+/**
+ * Every operator * above returns a finished, normalized temporary, so a * b * c * d pays for three
+ * normalizations where one would do. Rational5 makes operator * and operator + return lightweight expression
+ * objects instead, and the whole expression is evaluated when it is assigned to a Rational5: the products and
+ * sums are accumulated unreduced in the wider type, and the result is normalized once.
+ *
+ * An intermediate that would overflow the wider type is reduced and retried first, so only results that
+ * really don't fit throw RationalOverflow.
+ *
+ * Mixed-mode arithmetic still works the way Rational2 does it: the operators that take a Rational5 are
+ * non-template friends, so oneHalf * 2, 2 * oneHalf and (oneHalf * oneHalf) * 2 all convert the int.
+*/
+template <typename T>
+class Rational5;
+
+template <typename L, typename R, typename T>
+class RationalProduct;
+
+template <typename L, typename R, typename T>
+class RationalSum;
+
+
+namespace RationalDetail
+{
+    // An unreduced numerator and denominator, with a nonzero denominator of either sign
+    template <typename Wide>
+    struct Fraction
+    {
+        Wide numerator;
+        Wide denominator;
+    };
+
+
+    template <typename Wide>
+    constexpr Fraction<Wide> reduce(Fraction<Wide> fraction) noexcept
+    {
+        Wide divisor = static_cast<Wide>(binaryGcd(magnitude(fraction.numerator), magnitude(fraction.denominator)));
+
+        return { fraction.numerator / divisor, fraction.denominator / divisor };
+    }
+
+
+    template <typename Wide>
+    constexpr Fraction<Wide> multiply(Fraction<Wide> lhs, Fraction<Wide> rhs)
+    {
+        Fraction<Wide> result {};
+
+        if (!__builtin_mul_overflow(lhs.numerator, rhs.numerator, &result.numerator) &&
+            !__builtin_mul_overflow(lhs.denominator, rhs.denominator, &result.denominator))
+        {
+            return result;
+        }
+
+        // Reduced and cross-reduced, the product is in lowest terms, so if it still overflows it can't fit
+        lhs = reduce(lhs);
+        rhs = reduce(rhs);
+
+        Wide left = static_cast<Wide>(binaryGcd(magnitude(lhs.numerator), magnitude(rhs.denominator)));
+        Wide right = static_cast<Wide>(binaryGcd(magnitude(rhs.numerator), magnitude(lhs.denominator)));
+
+        if (__builtin_mul_overflow(lhs.numerator / left, rhs.numerator / right, &result.numerator) ||
+            __builtin_mul_overflow(lhs.denominator / right, rhs.denominator / left, &result.denominator))
+        {
+            throw RationalOverflow("Rational5: product does not fit even in lowest terms");
+        }
+
+        return result;
+    }
+
+
+    template <typename Wide>
+    constexpr bool trySum(Fraction<Wide> lhs, Fraction<Wide> rhs, Fraction<Wide>& result) noexcept
+    {
+        Wide left = 0;
+        Wide right = 0;
+
+        return !__builtin_mul_overflow(lhs.numerator, rhs.denominator, &left) &&
+               !__builtin_mul_overflow(rhs.numerator, lhs.denominator, &right) &&
+               !__builtin_add_overflow(left, right, &result.numerator) &&
+               !__builtin_mul_overflow(lhs.denominator, rhs.denominator, &result.denominator);
+    }
+
+    template <typename Wide>
+    constexpr Fraction<Wide> add(Fraction<Wide> lhs, Fraction<Wide> rhs)
+    {
+        Fraction<Wide> result {};
+
+        if (trySum(lhs, rhs, result))
+        {
+            return result;
+        }
+
+        // Retry over the least common denominator of the reduced operands
+        lhs = reduce(lhs);
+        rhs = reduce(rhs);
+
+        Wide divisor = static_cast<Wide>(binaryGcd(magnitude(lhs.denominator), magnitude(rhs.denominator)));
+
+        if (!trySum({ lhs.numerator, lhs.denominator / divisor }, { rhs.numerator, rhs.denominator / divisor }, result) ||
+            __builtin_mul_overflow(result.denominator, divisor, &result.denominator))
+        {
+            throw RationalOverflow("Rational5: sum does not fit even over the least common denominator");
+        }
+
+        return result;
+    }
+}
+
+
+/**
+ * The base of every expression node. Its hidden friends let an expression combine with a Rational5 on either
+ * side, converting ints along the way, or with another expression.
+*/
+template <typename Derived, typename T>
+class RationalExpression
+{
+    public:
+        constexpr const Derived& self() const noexcept
+        {
+            return static_cast<const Derived&>(*this);
+        }
+
+        friend constexpr RationalProduct<Derived, Rational5<T>, T> operator * (const Derived& lhs, const Rational5<T>& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        friend constexpr RationalProduct<Rational5<T>, Derived, T> operator * (const Rational5<T>& lhs, const Derived& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        friend constexpr RationalSum<Derived, Rational5<T>, T> operator + (const Derived& lhs, const Rational5<T>& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        friend constexpr RationalSum<Rational5<T>, Derived, T> operator + (const Rational5<T>& lhs, const Derived& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        // Both operands match exactly, so these beat the overloads above that would convert one side to Rational5
+        template <typename Other, typename = std::enable_if_t<std::is_base_of_v<RationalExpression<Other, T>, Other>>>
+        friend constexpr RationalProduct<Derived, Other, T> operator * (const Derived& lhs, const Other& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        template <typename Other, typename = std::enable_if_t<std::is_base_of_v<RationalExpression<Other, T>, Other>>>
+        friend constexpr RationalSum<Derived, Other, T> operator + (const Derived& lhs, const Other& rhs)
+        {
+            return { lhs, rhs };
+        }
+};
+
+
+// Operands are held by value: a leaf is just two integers, and nothing dangles if an expression outlives its statement
+template <typename L, typename R, typename T>
+class RationalProduct : public RationalExpression<RationalProduct<L, R, T>, T>
+{
+    public:
+        constexpr RationalProduct(const L& lhs, const R& rhs)
+            : m_lhs { lhs }, m_rhs { rhs } {}
+
+        constexpr RationalDetail::Fraction<RationalDetail::WiderType<T>> fraction() const
+        {
+            return RationalDetail::multiply(m_lhs.fraction(), m_rhs.fraction());
+        }
+
+    private:
+        L m_lhs;
+        R m_rhs;
+};
+
+
+template <typename L, typename R, typename T>
+class RationalSum : public RationalExpression<RationalSum<L, R, T>, T>
+{
+    public:
+        constexpr RationalSum(const L& lhs, const R& rhs)
+            : m_lhs { lhs }, m_rhs { rhs } {}
+
+        constexpr RationalDetail::Fraction<RationalDetail::WiderType<T>> fraction() const
+        {
+            return RationalDetail::add(m_lhs.fraction(), m_rhs.fraction());
+        }
+
+    private:
+        L m_lhs;
+        R m_rhs;
+};
+
+
+template <typename T>
+class Rational5
+{
+    using Wide = RationalDetail::WiderType<T>;
+
+    public:
+        constexpr Rational5(const T& numerator = 0, const T& denominator = 1)
+        {
+            assign({ numerator, denominator });
+        }
+
+        // Evaluating an expression is the one place anything gets normalized
+        template <typename Expression>
+        constexpr Rational5(const RationalExpression<Expression, T>& expression)
+        {
+            assign(expression.self().fraction());
+        }
+
+        constexpr T numerator() const noexcept
+        {
+            return m_numerator;
+        }
+
+        constexpr T denominator() const noexcept
+        {
+            return m_denominator;
+        }
+
+        constexpr RationalDetail::Fraction<Wide> fraction() const noexcept
+        {
+            return { m_numerator, m_denominator };
+        }
+
+        friend constexpr RationalProduct<Rational5, Rational5, T> operator * (const Rational5& lhs, const Rational5& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        friend constexpr RationalSum<Rational5, Rational5, T> operator + (const Rational5& lhs, const Rational5& rhs)
+        {
+            return { lhs, rhs };
+        }
+
+        friend constexpr bool operator == (const Rational5& lhs, const Rational5& rhs) noexcept
+        {
+            return lhs.m_numerator == rhs.m_numerator && lhs.m_denominator == rhs.m_denominator;
+        }
+
+        friend constexpr bool operator != (const Rational5& lhs, const Rational5& rhs) noexcept
+        {
+            return !(lhs == rhs);
+        }
+
+
+    private:
+        T m_numerator = 0;
+        T m_denominator = 1;
+
+        constexpr void assign(RationalDetail::Fraction<Wide> fraction)
+        {
+            if (fraction.denominator == 0)
+            {
+                throw std::domain_error("Rational5: zero denominator");
+            }
+
+            fraction = RationalDetail::reduce(fraction);
+
+            if (fraction.denominator < 0)
+            {
+                fraction = { -fraction.numerator, -fraction.denominator };
+            }
+
+            if (fraction.numerator < std::numeric_limits<T>::min() || fraction.numerator > std::numeric_limits<T>::max() ||
+                fraction.denominator > std::numeric_limits<T>::max())
+            {
+                throw RationalOverflow("Rational5: result does not fit the underlying integer type");
+            }
+
+            m_numerator = static_cast<T>(fraction.numerator);
+            m_denominator = static_cast<T>(fraction.denominator);
+        }
+};
+
+
+Rational5<std::int64_t> oneQuarter { 1, 4 };
+Rational5<std::int64_t> result4 = oneQuarter * 2 * 2 + 1;      // One normalization, to 2/1
+
+
+/**
+ * Evaluates out[i] = a[i] * b[i] * c[i] * d[i] * e[i] * f[i] * g[i] * h[i] with Rational4, which normalizes
+ * every intermediate product, and with Rational5, which normalizes each result once, then does the same for
+ * a sum of four terms.
+*/
+struct ExpressionTiming
+{
+    double rational4ProductNanoseconds;
+    double rational5ProductNanoseconds;
+    double rational4SumNanoseconds;
+    double rational5SumNanoseconds;
+    bool agree;
+};
+
+template <typename T>
+ExpressionTiming benchmarkExpressions(std::size_t count, int repetitions = 10)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<T> numerators(count * 8);
+    std::vector<T> denominators(count * 8);
+    std::uint32_t state = 12345;
+
+    for (std::size_t i = 0; i < numerators.size(); ++i)
+    {
+        state = state * 1664525 + 1013904223;
+        numerators[i] = static_cast<T>(state >> 26) + 1;        // 1..64, so eight-factor products fit std::int64_t
+        state = state * 1664525 + 1013904223;
+        denominators[i] = static_cast<T>(state >> 26) + 1;
+    }
+
+    std::vector<Rational4<T>> values4;
+    std::vector<Rational5<T>> values5;
+
+    for (std::size_t i = 0; i < numerators.size(); ++i)
+    {
+        values4.emplace_back(numerators[i], denominators[i]);
+        values5.emplace_back(numerators[i], denominators[i]);
+    }
+
+    std::vector<Rational4<T>> out4(count);
+    std::vector<Rational5<T>> out5(count);
+
+    auto time = [&](auto body)
+    {
+        auto start = Clock::now();
+
+        for (int r = 0; r < repetitions; ++r)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                body(i * 8);
+            }
+        }
+
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double(count) * repetitions);
+    };
+
+    auto agree = [&]
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (out4[i].numerator() != out5[i].numerator() || out4[i].denominator() != out5[i].denominator())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    ExpressionTiming timing {};
+    const auto& v4 = values4;
+    const auto& v5 = values5;
+
+    timing.rational4ProductNanoseconds = time([&](std::size_t j)
+    {
+        out4[j / 8] = v4[j] * v4[j + 1] * v4[j + 2] * v4[j + 3] * v4[j + 4] * v4[j + 5] * v4[j + 6] * v4[j + 7];
+    });
+
+    timing.rational5ProductNanoseconds = time([&](std::size_t j)
+    {
+        out5[j / 8] = v5[j] * v5[j + 1] * v5[j + 2] * v5[j + 3] * v5[j + 4] * v5[j + 5] * v5[j + 6] * v5[j + 7];
+    });
+
+    timing.agree = agree();
+
+    timing.rational4SumNanoseconds = time([&](std::size_t j)
+    {
+        out4[j / 8] = v4[j] + v4[j + 1] + v4[j + 2] + v4[j + 3];
+    });
+
+    timing.rational5SumNanoseconds = time([&](std::size_t j)
+    {
+        out5[j / 8] = v5[j] + v5[j + 1] + v5[j + 2] + v5[j + 3];
+    });
+
+    timing.agree = timing.agree && agree();
+
+    return timing;
+}
+
+
+
+/**
+ * Columns of rationals go through operator * one element at a time, and an array of Rational4 interleaves
+ * numerators with denominators. RationalVector stores them as two separate arrays of std::int32_t, every
+ * element in lowest terms, so eight elements load into one AVX2 register.
+ *
+ * The kernels use the same algorithms as Rational4, vectorized: an eight-lane binary GCD (trailing zeros come
+ * from the exponent of the lowest set bit converted to float), exact quotients and range checks in double,
+ * and 64-bit cross products for comparisons. A block of eight where any lane leaves that fast range (a
+ * result that doesn't fit, a sum whose intermediates exceed 2^52, a zero denominator) is redone by the
+ * scalar code, which produces the right answer or throws exactly as Rational4 would.
+ *
+ * The AVX2 kernels are compiled with a target attribute and picked at run time, so the same binary runs on
+ * CPUs without AVX2, where everything goes through the scalar kernels.
+*/
+enum class RationalKernel
+{
+    Automatic,      // AVX2 when the CPU has it
+    Scalar
+};
+
+
+class RationalVector
+{
+    public:
+        using value_type = Rational4<std::int32_t>;
+
+        RationalVector() = default;
+
+        explicit RationalVector(std::size_t size)
+            : m_numerators(size, 0), m_denominators(size, 1) {}
+
+        // Reduces every element to lowest terms
+        RationalVector(std::vector<std::int32_t> numerators, std::vector<std::int32_t> denominators,
+                       RationalKernel kernel = RationalKernel::Automatic);
+
+        std::size_t size() const noexcept
+        {
+            return m_numerators.size();
+        }
+
+        void push_back(const value_type& value)
+        {
+            m_numerators.push_back(value.numerator());
+            m_denominators.push_back(value.denominator());
+        }
+
+        value_type operator [] (std::size_t index) const
+        {
+            return value_type::fromLowestTerms(m_numerators[index], m_denominators[index]);
+        }
+
+        const std::int32_t* numerators() const noexcept
+        {
+            return m_numerators.data();
+        }
+
+        const std::int32_t* denominators() const noexcept
+        {
+            return m_denominators.data();
+        }
+
+        // For kernels that write results in place, which must leave every element in lowest terms
+        std::int32_t* numerators() noexcept
+        {
+            return m_numerators.data();
+        }
+
+        std::int32_t* denominators() noexcept
+        {
+            return m_denominators.data();
+        }
+
+
+    private:
+        std::vector<std::int32_t> m_numerators;
+        std::vector<std::int32_t> m_denominators;
+};
+
+
+// Non-member non-friends, like the arithmetic operators (Item 23)
+RationalVector multiply(const RationalVector& lhs, const RationalVector& rhs, RationalKernel kernel = RationalKernel::Automatic);
+RationalVector add(const RationalVector& lhs, const RationalVector& rhs, RationalKernel kernel = RationalKernel::Automatic);
+
+// 1 where lhs[i] < rhs[i], 0 elsewhere
+std::vector<std::uint8_t> less(const RationalVector& lhs, const RationalVector& rhs,
+                               RationalKernel kernel = RationalKernel::Automatic);
+
+
+namespace RationalVectorKernels
+{
+    // Pointers to the columns of the operands and the result, shared by the scalar and AVX2 kernels
+    struct Columns
+    {
+        const std::int32_t* lhsNumerators;
+        const std::int32_t* lhsDenominators;
+        const std::int32_t* rhsNumerators;
+        const std::int32_t* rhsDenominators;
+        std::int32_t* numerators;
+        std::int32_t* denominators;
+    };
+
+
+    void normalizeScalar(Columns columns, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            Rational4<std::int32_t> value(columns.lhsNumerators[i], columns.lhsDenominators[i]);
+
+            columns.numerators[i] = value.numerator();
+            columns.denominators[i] = value.denominator();
+        }
+    }
+
+    void multiplyScalar(Columns columns, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            // Both operands are RationalVector elements, already in lowest terms
+            Rational4<std::int32_t> value =
+                Rational4<std::int32_t>::fromLowestTerms(columns.lhsNumerators[i], columns.lhsDenominators[i]) *
+                Rational4<std::int32_t>::fromLowestTerms(columns.rhsNumerators[i], columns.rhsDenominators[i]);
+
+            columns.numerators[i] = value.numerator();
+            columns.denominators[i] = value.denominator();
+        }
+    }
+
+    void addScalar(Columns columns, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            // Both operands are RationalVector elements, already in lowest terms
+            Rational4<std::int32_t> value =
+                Rational4<std::int32_t>::fromLowestTerms(columns.lhsNumerators[i], columns.lhsDenominators[i]) +
+                Rational4<std::int32_t>::fromLowestTerms(columns.rhsNumerators[i], columns.rhsDenominators[i]);
+
+            columns.numerators[i] = value.numerator();
+            columns.denominators[i] = value.denominator();
+        }
+    }
+
+    void lessScalar(Columns columns, std::uint8_t* result, std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            result[i] = static_cast<std::int64_t>(columns.lhsNumerators[i]) * columns.rhsDenominators[i] <
+                        static_cast<std::int64_t>(columns.rhsNumerators[i]) * columns.lhsDenominators[i];
+        }
+    }
+
+
+#if defined(__x86_64__)
+    constexpr std::size_t lanes = 8;
+
+    // Per lane; lanes holding zero come out as a shift of 32 or more, which _mm256_srlv_epi32 turns into zero
+    __attribute__((target("avx2"))) inline __m256i trailingZeros(__m256i value)
+    {
+        __m256i lowest = _mm256_and_si256(value, _mm256_sub_epi32(_mm256_setzero_si256(), value));
+        __m256i bits = _mm256_castps_si256(_mm256_cvtepi32_ps(lowest));
+
+        return _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xFF)),
+                                _mm256_set1_epi32(127));
+    }
+
+    // Binary GCD of unsigned lanes, b nonzero in every lane; runs until the slowest lane finishes
+    __attribute__((target("avx2"))) inline __m256i gcd(__m256i a, __m256i b)
+    {
+        __m256i zero = _mm256_setzero_si256();
+        __m256i shift = trailingZeros(_mm256_or_si256(a, b));
+
+        a = _mm256_blendv_epi8(a, b, _mm256_cmpeq_epi32(a, zero));      // gcd(0, b) is gcd(b, b)
+        a = _mm256_srlv_epi32(a, trailingZeros(a));
+
+        while (!_mm256_testz_si256(b, b))
+        {
+            b = _mm256_srlv_epi32(b, trailingZeros(b));
+
+            __m256i finished = _mm256_cmpeq_epi32(b, zero);
+            __m256i low = _mm256_min_epu32(a, b);
+            __m256i high = _mm256_max_epu32(a, b);
+
+            a = _mm256_blendv_epi8(low, a, finished);
+            b = _mm256_andnot_si256(finished, _mm256_sub_epi32(high, low));
+        }
+
+        return _mm256_sllv_epi32(a, shift);
+    }
+
+    __attribute__((target("avx2"))) inline __m256d half(__m256i value, int which)
+    {
+        return _mm256_cvtepi32_pd(which == 0 ? _mm256_castsi256_si128(value) : _mm256_extracti128_si256(value, 1));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i join(__m256d low, __m256d high)
+    {
+        return _mm256_set_m128i(_mm256_cvttpd_epi32(high), _mm256_cvttpd_epi32(low));
+    }
+
+    // Lanes outside [INT32_MIN, INT32_MAX], as a bit mask
+    __attribute__((target("avx2"))) inline int outOfRange(__m256d value)
+    {
+        __m256d above = _mm256_cmp_pd(value, _mm256_set1_pd(std::numeric_limits<std::int32_t>::max()), _CMP_GT_OQ);
+        __m256d below = _mm256_cmp_pd(value, _mm256_set1_pd(std::numeric_limits<std::int32_t>::min()), _CMP_LT_OQ);
+
+        return _mm256_movemask_pd(_mm256_or_pd(above, below));
+    }
+
+    __attribute__((target("avx2"))) inline __m256i load(const std::int32_t* source)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+    }
+
+    __attribute__((target("avx2"))) inline void store(std::int32_t* destination, __m256i value)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination), value);
+    }
+
+    // Zero is 0/1 whatever the denominator worked out to
+    __attribute__((target("avx2"))) inline __m256i canonicalDenominator(__m256i numerator, __m256i denominator)
+    {
+        return _mm256_blendv_epi8(denominator, _mm256_set1_epi32(1), _mm256_cmpeq_epi32(numerator, _mm256_setzero_si256()));
+    }
+
+
+    __attribute__((target("avx2"))) void normalizeAvx2(Columns columns, std::size_t begin, std::size_t end)
+    {
+        __m256i mostNegative = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+        std::size_t i = begin;
+
+        for (; i + lanes <= end; i += lanes)
+        {
+            __m256i numerator = load(columns.lhsNumerators + i);
+            __m256i denominator = load(columns.lhsDenominators + i);
+
+            // Zero denominators throw, and the most negative value has no magnitude in int32
+            __m256i special = _mm256_or_si256(_mm256_cmpeq_epi32(denominator, _mm256_setzero_si256()),
+                                              _mm256_or_si256(_mm256_cmpeq_epi32(numerator, mostNegative),
+                                                              _mm256_cmpeq_epi32(denominator, mostNegative)));
+
+            if (!_mm256_testz_si256(special, special))
+            {
+                normalizeScalar(columns, i, i + lanes);
+                continue;
+            }
+
+            __m256i divisor = gcd(_mm256_abs_epi32(numerator), _mm256_abs_epi32(denominator));
+            __m256i sign = _mm256_or_si256(_mm256_srai_epi32(denominator, 31), _mm256_set1_epi32(1));     // -1 or 1
+            __m256d results[2][2];
+
+            for (int h = 0; h < 2; ++h)
+            {
+                __m256d scale = half(sign, h);
+
+                results[0][h] = _mm256_mul_pd(_mm256_div_pd(half(numerator, h), half(divisor, h)), scale);
+                results[1][h] = _mm256_mul_pd(_mm256_div_pd(half(denominator, h), half(divisor, h)), scale);
+            }
+
+            numerator = join(results[0][0], results[0][1]);
+            store(columns.numerators + i, numerator);
+            store(columns.denominators + i, canonicalDenominator(numerator, join(results[1][0], results[1][1])));
+        }
+
+        normalizeScalar(columns, i, end);
+    }
+
+
+    __attribute__((target("avx2"))) void multiplyAvx2(Columns columns, std::size_t begin, std::size_t end)
+    {
+        std::size_t i = begin;
+
+        for (; i + lanes <= end; i += lanes)
+        {
+            __m256i a = load(columns.lhsNumerators + i);
+            __m256i b = load(columns.lhsDenominators + i);
+            __m256i c = load(columns.rhsNumerators + i);
+            __m256i d = load(columns.rhsDenominators + i);
+
+            // Cross-reduce, as Rational4 does, so the products come out in lowest terms
+            __m256i left = gcd(_mm256_abs_epi32(a), d);
+            __m256i right = gcd(_mm256_abs_epi32(c), b);
+
+            __m256d numerators[2];
+            __m256d denominators[2];
+            int overflow = 0;
+
+            for (int h = 0; h < 2; ++h)
+            {
+                numerators[h] = _mm256_mul_pd(_mm256_div_pd(half(a, h), half(left, h)),
+                                              _mm256_div_pd(half(c, h), half(right, h)));
+                denominators[h] = _mm256_mul_pd(_mm256_div_pd(half(b, h), half(right, h)),
+                                                _mm256_div_pd(half(d, h), half(left, h)));
+
+                overflow |= outOfRange(numerators[h]) | outOfRange(denominators[h]);
+            }
+
+            if (overflow)
+            {
+                multiplyScalar(columns, i, i + lanes);
+                continue;
+            }
+
+            __m256i numerator = join(numerators[0], numerators[1]);
+
+            store(columns.numerators + i, numerator);
+            store(columns.denominators + i, canonicalDenominator(numerator, join(denominators[0], denominators[1])));
+        }
+
+        multiplyScalar(columns, i, end);
+    }
+
+
+    __attribute__((target("avx2"))) void addAvx2(Columns columns, std::size_t begin, std::size_t end)
+    {
+        __m256d exactLimit = _mm256_set1_pd(4503599627370496.0);    // 2^52
+        __m256d signBit = _mm256_set1_pd(-0.0);
+        std::size_t i = begin;
+
+        for (; i + lanes <= end; i += lanes)
+        {
+            __m256i a = load(columns.lhsNumerators + i);
+            __m256i b = load(columns.lhsDenominators + i);
+            __m256i c = load(columns.rhsNumerators + i);
+            __m256i d = load(columns.rhsDenominators + i);
+
+            // Knuth: sum over the least common denominator, then only the denominators' GCD can divide the result
+            __m256i divisor = gcd(b, d);
+            __m256d sums[2];
+            __m256d scaledLeft[2];
+            int overflow = 0;
+
+            for (int h = 0; h < 2; ++h)
+            {
+                scaledLeft[h] = _mm256_div_pd(half(b, h), half(divisor, h));
+
+                __m256d first = _mm256_mul_pd(half(a, h), _mm256_div_pd(half(d, h), half(divisor, h)));
+                __m256d second = _mm256_mul_pd(half(c, h), scaledLeft[h]);
+
+                sums[h] = _mm256_add_pd(first, second);
+
+                __m256d inexact = _mm256_or_pd(_mm256_cmp_pd(_mm256_andnot_pd(signBit, first), exactLimit, _CMP_GE_OQ),
+                                               _mm256_cmp_pd(_mm256_andnot_pd(signBit, second), exactLimit, _CMP_GE_OQ));
+
+                overflow |= _mm256_movemask_pd(inexact) | outOfRange(sums[h]);
+            }
+
+            if (overflow)
+            {
+                addScalar(columns, i, i + lanes);
+                continue;
+            }
+
+            __m256i sum = join(sums[0], sums[1]);
+            __m256i common = gcd(_mm256_abs_epi32(sum), divisor);
+            __m256d numerators[2];
+            __m256d denominators[2];
+
+            for (int h = 0; h < 2; ++h)
+            {
+                numerators[h] = _mm256_div_pd(sums[h], half(common, h));
+                denominators[h] = _mm256_mul_pd(scaledLeft[h], _mm256_div_pd(half(d, h), half(common, h)));
+
+                overflow |= outOfRange(denominators[h]);
+            }
+
+            if (overflow)
+            {
+                addScalar(columns, i, i + lanes);
+                continue;
+            }
+
+            __m256i numerator = join(numerators[0], numerators[1]);
+
+            store(columns.numerators + i, numerator);
+            store(columns.denominators + i, canonicalDenominator(numerator, join(denominators[0], denominators[1])));
+        }
+
+        addScalar(columns, i, end);
+    }
+
+
+    __attribute__((target("avx2"))) void lessAvx2(Columns columns, std::uint8_t* result, std::size_t begin, std::size_t end)
+    {
+        std::size_t i = begin;
+
+        for (; i + lanes <= end; i += lanes)
+        {
+            __m256i a = load(columns.lhsNumerators + i);
+            __m256i b = load(columns.lhsDenominators + i);
+            __m256i c = load(columns.rhsNumerators + i);
+            __m256i d = load(columns.rhsDenominators + i);
+
+            // a * d < c * b, exactly, in 64-bit lanes: even elements, then odd ones shifted down
+            __m256i evenLess = _mm256_cmpgt_epi64(_mm256_mul_epi32(c, b), _mm256_mul_epi32(a, d));
+            __m256i oddLess = _mm256_cmpgt_epi64(_mm256_mul_epi32(_mm256_srli_epi64(c, 32), _mm256_srli_epi64(b, 32)),
+                                                 _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(d, 32)));
+
+            int even = _mm256_movemask_pd(_mm256_castsi256_pd(evenLess));
+            int odd = _mm256_movemask_pd(_mm256_castsi256_pd(oddLess));
+
+            for (std::size_t lane = 0; lane < lanes / 2; ++lane)
+            {
+                result[i + 2 * lane] = (even >> lane) & 1;
+                result[i + 2 * lane + 1] = (odd >> lane) & 1;
+            }
+        }
+
+        lessScalar(columns, result, i, end);
+    }
+
+
+    bool avx2Available() noexcept
+    {
+        static const bool available = __builtin_cpu_supports("avx2");
+
+        return available;
+    }
+#else
+    bool avx2Available() noexcept
+    {
+        return false;
+    }
+#endif
+
+
+    bool useAvx2(RationalKernel kernel) noexcept
+    {
+        return kernel == RationalKernel::Automatic && avx2Available();
+    }
+
+    void checkSizes(const RationalVector& lhs, const RationalVector& rhs)
+    {
+        if (lhs.size() != rhs.size())
+        {
+            throw std::invalid_argument("RationalVector: operands differ in size");
+        }
+    }
+}
+
+
+RationalVector::RationalVector(std::vector<std::int32_t> numerators, std::vector<std::int32_t> denominators,
+                               RationalKernel kernel)
+    : m_numerators(std::move(numerators)), m_denominators(std::move(denominators))
+{
+    if (m_numerators.size() != m_denominators.size())
+    {
+        throw std::invalid_argument("RationalVector: column sizes differ");
+    }
+
+    RationalVectorKernels::Columns columns { m_numerators.data(), m_denominators.data(), nullptr, nullptr,
+                                             m_numerators.data(), m_denominators.data() };
+
+#if defined(__x86_64__)
+    if (RationalVectorKernels::useAvx2(kernel))
+    {
+        RationalVectorKernels::normalizeAvx2(columns, 0, size());
+        return;
+    }
+#endif
+
+    RationalVectorKernels::normalizeScalar(columns, 0, size());
+}
+
+
+RationalVector multiply(const RationalVector& lhs, const RationalVector& rhs, RationalKernel kernel)
+{
+    RationalVectorKernels::checkSizes(lhs, rhs);
+
+    RationalVector result(lhs.size());
+    RationalVectorKernels::Columns columns { lhs.numerators(), lhs.denominators(), rhs.numerators(), rhs.denominators(),
+                                             result.numerators(), result.denominators() };
+
+#if defined(__x86_64__)
+    if (RationalVectorKernels::useAvx2(kernel))
+    {
+        RationalVectorKernels::multiplyAvx2(columns, 0, lhs.size());
+        return result;
+    }
+#endif
+
+    RationalVectorKernels::multiplyScalar(columns, 0, lhs.size());
+
+    return result;
+}
+
+
+RationalVector add(const RationalVector& lhs, const RationalVector& rhs, RationalKernel kernel)
+{
+    RationalVectorKernels::checkSizes(lhs, rhs);
+
+    RationalVector result(lhs.size());
+    RationalVectorKernels::Columns columns { lhs.numerators(), lhs.denominators(), rhs.numerators(), rhs.denominators(),
+                                             result.numerators(), result.denominators() };
+
+#if defined(__x86_64__)
+    if (RationalVectorKernels::useAvx2(kernel))
+    {
+        RationalVectorKernels::addAvx2(columns, 0, lhs.size());
+        return result;
+    }
+#endif
+
+    RationalVectorKernels::addScalar(columns, 0, lhs.size());
+
+    return result;
+}
+
+
+std::vector<std::uint8_t> less(const RationalVector& lhs, const RationalVector& rhs, RationalKernel kernel)
+{
+    RationalVectorKernels::checkSizes(lhs, rhs);
+
+    std::vector<std::uint8_t> result(lhs.size());
+    RationalVectorKernels::Columns columns { lhs.numerators(), lhs.denominators(), rhs.numerators(), rhs.denominators(),
+                                             nullptr, nullptr };
+
+#if defined(__x86_64__)
+    if (RationalVectorKernels::useAvx2(kernel))
+    {
+        RationalVectorKernels::lessAvx2(columns, result.data(), 0, lhs.size());
+        return result;
+    }
+#endif
+
+    RationalVectorKernels::lessScalar(columns, result.data(), 0, lhs.size());
+
+    return result;
+}
+
+
+/**
+ * Elements per second for an elementwise product of two columns of count random rationals: the scalar
+ * operator * loop over std::vector<Rational4<std::int32_t>>, then RationalVector with each kernel.
+*/
+struct ColumnThroughput
+{
+    double operatorLoop;
+    double scalarKernel;
+    double avx2Kernel;      // Same as scalarKernel without AVX2
+    bool agree;
+};
+
+ColumnThroughput benchmarkColumnMultiply(std::size_t count, int repetitions = 20)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::int32_t> numerators(count * 2);
+    std::vector<std::int32_t> denominators(count * 2);
+    std::uint32_t state = 2463534242u;
+
+    for (std::size_t i = 0; i < numerators.size(); ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        numerators[i] = static_cast<std::int32_t>(state % 20001) - 10000;
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        denominators[i] = static_cast<std::int32_t>(state % 10000) + 1;
+    }
+
+    std::vector<Rational4<std::int32_t>> lhsValues;
+    std::vector<Rational4<std::int32_t>> rhsValues;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        lhsValues.emplace_back(numerators[i], denominators[i]);
+        rhsValues.emplace_back(numerators[count + i], denominators[count + i]);
+    }
+
+    RationalVector lhs(std::vector<std::int32_t>(numerators.begin(), numerators.begin() + count),
+                       std::vector<std::int32_t>(denominators.begin(), denominators.begin() + count));
+    RationalVector rhs(std::vector<std::int32_t>(numerators.begin() + count, numerators.end()),
+                       std::vector<std::int32_t>(denominators.begin() + count, denominators.end()));
+
+    auto elementsPerSecond = [&](auto body)
+    {
+        auto start = Clock::now();
+
+        for (int r = 0; r < repetitions; ++r)
+        {
+            body();
+        }
+
+        return double(count) * repetitions / std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    std::vector<Rational4<std::int32_t>> products(count);
+    RationalVector scalarProducts;
+    RationalVector avx2Products;
+    ColumnThroughput throughput {};
+
+    throughput.operatorLoop = elementsPerSecond([&]
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            products[i] = lhsValues[i] * rhsValues[i];
+        }
+    });
+
+    throughput.scalarKernel = elementsPerSecond([&] { scalarProducts = multiply(lhs, rhs, RationalKernel::Scalar); });
+    throughput.avx2Kernel = elementsPerSecond([&] { avx2Products = multiply(lhs, rhs); });
+
+    throughput.agree = std::equal(scalarProducts.numerators(), scalarProducts.numerators() + count, avx2Products.numerators()) &&
+                       std::equal(scalarProducts.denominators(), scalarProducts.denominators() + count, avx2Products.denominators());
+
+    for (std::size_t i = 0; i < count && throughput.agree; ++i)
+    {
+        throughput.agree = products[i] == avx2Products[i];
+    }
+
+    return throughput;
+}
+
+
+
+/**
+ * Everything in Rational4 and Rational5 is constexpr, normalization and comparison included, so tables of
+ * rational constants can be computed by the compiler instead of at startup. A constexpr variable must be
+ * constant-initialized, so these tables need no code at all to run before main, and the static_asserts
+ * check their contents while compiling. An entry that overflowed would throw RationalOverflow, which is not
+ * allowed in a constant expression, so it is a compile error rather than a startup failure.
+*/
+namespace RationalTables
+{
+    using Rational = Rational4<std::int64_t>;
+
+    // (1 + rate)^k for k = 0..Size-1, e.g. the growth of a balance compounding at rate per period
+    template <std::size_t Size>
+    constexpr std::array<Rational, Size> compoundGrowth(Rational rate)
+    {
+        std::array<Rational, Size> table {};
+        Rational factor = 1;
+
+        for (std::size_t k = 0; k < Size; ++k)
+        {
+            table[k] = factor;
+            factor = factor * (1 + rate);
+        }
+
+        return table;
+    }
+
+    // H(n) = 1 + 1/2 + ... + 1/n, for n = 1..Size
+    template <std::size_t Size>
+    constexpr std::array<Rational, Size> harmonicNumbers()
+    {
+        std::array<Rational, Size> table {};
+        Rational sum = 0;
+
+        for (std::size_t n = 1; n <= Size; ++n)
+        {
+            sum = sum + Rational(1, static_cast<std::int64_t>(n));
+            table[n - 1] = sum;
+        }
+
+        return table;
+    }
+
+
+    constexpr auto fivePercentGrowth = compoundGrowth<12>(Rational(5, 100));
+    constexpr auto harmonic = harmonicNumbers<20>();
+
+    static_assert(fivePercentGrowth[0] == 1);
+    static_assert(fivePercentGrowth[2] == Rational(441, 400));
+    static_assert(fivePercentGrowth[11] > fivePercentGrowth[10]);
+    static_assert(harmonic[3] == Rational(25, 12));
+    static_assert(harmonic[19] == Rational(55835135, 15519504));
+
+    static_assert(Rational(6, -4).numerator() == -3 && Rational(6, -4).denominator() == 2);
+    static_assert(Rational(1, 3) < Rational(1, 2) && Rational(-1, 2) <= Rational(-2, 4));
+    static_assert(Rational(1, 2) * 2 == 1 && 2 - Rational(1, 2) == Rational(3, 2));
+    static_assert(Rational5<std::int64_t>(Rational5<std::int64_t>(1, 2) * 2 * 3 + 1) == 4);
+}
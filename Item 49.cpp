@@ -1,3 +1,5 @@
+#include <chrono>
+#include <cstddef>
 #include <new>
 /**
  * Understand the behavior of the new-handler.
@@ -150,4 +152,168 @@ void* NewHandlerSupport<T>::operator new(std::size_t size) throw(std::bad_alloc)
     return ::operator new(size);
 }
 
-class Example2 : public NewHandlerSupport<Example> { /* Same as before */ };
\ No newline at end of file
+class Example2 : public NewHandlerSupport<Example> { /* Same as before */ };
+
+
+/**
+ * NewHandlerSupport only decides which new-handler runs, every allocation still goes to the global heap.
+ * For classes that are created and destroyed millions of times, a mixin built on top of it can also own
+ * the memory (Item 50): all objects of T have the same size, so a free list of fixed-size blocks carved out
+ * of large slabs turns operator new and operator delete into a couple of pointer moves.
+ *
+ * The conventions of Item 51 still apply:
+ *
+ * 1. Requests of the "wrong" size (i.e. from a class derived from T) are forwarded to the global operator new.
+ *
+ * 2. Refilling the free list goes through NewHandlerSupport<T>::operator new, so T's new-handler, the one set with
+ *    the inherited set_new_handler, is retried exactly as before, and bad_alloc propagates with the original handler restored.
+ *
+ * 3. Deleting the null pointer does nothing.
+ *
+ * Blocks are aligned for std::max_align_t, so T may not be over-aligned.
+ * Slabs are never returned to the heap, and the free list is not synchronized. Use one pool per thread,
+ * or guard it with a Lock (Item 14), if objects of T are allocated from more than one thread.
+*/
+template <typename T>
+class PooledNewHandlerSupport : public NewHandlerSupport<T>
+{
+    public:
+        static void* operator new (std::size_t size);
+        static void operator delete (void* p_memory, std::size_t size) noexcept;
+
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        // sizeof(T) is unknown until T is complete, so the block size is only computed inside member functions
+        static constexpr std::size_t blockSize()
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "Pool blocks are only aligned for std::max_align_t");
+
+            constexpr std::size_t alignment = alignof(std::max_align_t);
+            constexpr std::size_t size = sizeof(T) < sizeof(FreeBlock) ? sizeof(FreeBlock) : sizeof(T);
+
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        static void refill();
+
+        static constexpr std::size_t blocksPerSlab = 512;
+
+        static inline FreeBlock* freeList = 0;
+};
+
+
+template <typename T>
+void PooledNewHandlerSupport<T>::refill()
+{
+    // T's new-handler is retried until the slab is allocated or it throws
+    char* slab = static_cast<char*>(NewHandlerSupport<T>::operator new(blockSize() * blocksPerSlab));
+
+    // Thread the new blocks onto the free list, the last block of the slab ends up at the front
+    for (std::size_t i = 0; i < blocksPerSlab; ++i)
+    {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * blockSize());
+        block->next = freeList;
+        freeList = block;
+    }
+}
+
+
+template <typename T>
+void* PooledNewHandlerSupport<T>::operator new (std::size_t size)
+{
+    // Objects of a derived class are not the size the pool was built for
+    if (size != sizeof(T))
+    {
+        return NewHandlerSupport<T>::operator new(size);
+    }
+
+    if (freeList == 0)
+    {
+        refill();
+    }
+
+    FreeBlock* block = freeList;
+    freeList = block->next;
+
+    return block;
+}
+
+
+template <typename T>
+void PooledNewHandlerSupport<T>::operator delete (void* p_memory, std::size_t size) noexcept
+{
+    if (p_memory == 0)
+    {
+        return;
+    }
+
+    // The size tells us whether the block came from the pool, no header is needed
+    if (size != sizeof(T))
+    {
+        ::operator delete(p_memory);
+
+        return;
+    }
+
+    FreeBlock* block = static_cast<FreeBlock*>(p_memory);
+    block->next = freeList;
+    freeList = block;
+}
+
+
+class Example3 : public PooledNewHandlerSupport<Example3>
+{
+    private:
+        double m_values[3];
+};
+
+
+/**
+ * Allocating and releasing the same number of Example3 objects through the pool and through the global heap
+ * shows what the pool saves. Keep a batch alive at a time so the global heap can't just hand back the same block.
+*/
+class Example4
+{
+    private:
+        double m_values[3];
+};
+
+template <typename Object>
+std::chrono::nanoseconds timeAllocations(std::size_t rounds)
+{
+    constexpr std::size_t batch = 1024;
+    Object* objects[batch];
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            objects[i] = new Object;
+        }
+
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            delete objects[i];
+        }
+    }
+
+    return std::chrono::steady_clock::now() - start;
+}
+
+struct AllocationTimes
+{
+    std::chrono::nanoseconds pooled;    // Free-list pool
+    std::chrono::nanoseconds global;    // Global operator new and operator delete
+};
+
+AllocationTimes compareAllocations(std::size_t rounds = 10'000)
+{
+    return { timeAllocations<Example3>(rounds), timeAllocations<Example4>(rounds) };
+}
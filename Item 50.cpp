@@ -1,3 +1,16 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 /**
  * Understand when it makes sense to replace new and delete.
 */
@@ -55,4 +68,834 @@
  *
  * 6. To cluster related objects near one another. Sometimes you want operators new and delete to do something that
  * the compiler-provided versions don’t offer.
-*/
\ No newline at end of file
+*/
+
+
+
+/**
+ * Reasons 1 and 2 together: a guarded heap that detects usage errors and collects statistics.
+ *
+ * Every block gets a header in front of it and a guard word behind it:
+ *
+ *     [ requested size | signature ][ user memory ... ][ tail signature ]
+ *
+ * operator delete checks both signatures. A header signature that says "freed" means a double delete,
+ * any other value means the header was overwritten (an underrun, or a pointer that never came from this heap).
+ * A damaged tail signature means the client wrote past the end of the block.
+ *
+ * After a block passes the checks, its header is marked freed, but the memory doesn't go back to the system
+ * right away: the system allocator writes its own free-list links over the first bytes of a freed chunk, which
+ * is exactly where our header is. Instead each thread keeps its last quarantineSize freed blocks in a quarantine
+ * and only hands the oldest one back to std::free, so a double delete of any recently freed block still finds
+ * the freed signature. Older blocks may already be reused, so such a double delete may be reported as a
+ * damaged header instead, but it is still reported.
+ *
+ * The header is as large as alignof(std::max_align_t), so the pointer handed to the client keeps
+ * the alignment guarantee discussed above. The tail signature is not aligned, so it is copied with memcpy.
+ *
+ * Statistics are atomics with relaxed ordering and there is no lock anywhere, so the mode can stay on in production.
+ * Shared counters that every thread increments would cost more than the checks themselves, so each thread counts
+ * into its own block, written with plain loads and stores and summed when statistics() is called.
+ * Live bytes are per thread too: each thread adds its allocations and frees to a private balance, and moves it to
+ * the shared total only when it passes liveBytesBatch either way. The peak is taken from the shared total, so it
+ * may be short by up to liveBytesBatch per thread.
+ *
+ * The mode is chosen once per process from the GUARDED_HEAP environment variable: a block allocated without
+ * a header must never be checked for one, so switching while blocks are live is not an option.
+*/
+namespace GuardedHeap
+{
+    enum class HeapError
+    {
+        DoubleDelete,
+        DamagedHeader,      // Underrun, or a pointer that didn't come from this heap
+        Overrun
+    };
+
+    using ErrorHandler = void (*)(HeapError error, void* p_memory);
+
+    constexpr std::size_t histogramBuckets = 48;     // Bucket n counts sizes in (2^(n-1), 2^n]
+
+    // A consistent-enough snapshot, each counter is read on its own
+    struct Statistics
+    {
+        std::uint64_t allocations;
+        std::uint64_t deallocations;
+        std::uint64_t liveBytes;
+        std::uint64_t peakBytes;
+        std::uint64_t errors;
+        std::uint64_t sizeHistogram[histogramBuckets];
+    };
+
+    bool enabled() noexcept;
+    Statistics statistics() noexcept;
+    ErrorHandler set_error_handler(ErrorHandler handler) noexcept;     // Same pattern as std::set_new_handler
+
+
+    namespace Detail
+    {
+        constexpr std::uint64_t liveSignature = 0xA110CA7EDB10C4A1;
+        constexpr std::uint64_t freedSignature = 0xF4EEDB10C4F4EED0;
+
+        struct alignas(std::max_align_t) Header
+        {
+            std::uint64_t size;
+            std::uint64_t signature;
+        };
+
+        constexpr std::size_t quarantineSize = 64;
+        constexpr std::int64_t liveBytesBatch = 64 * 1024;
+
+        // Written only by the owning thread, read by statistics(). Blocks are never freed, a new thread reuses
+        // the block of a thread that has exited, and its counts and quarantine simply carry on.
+        struct alignas(64) ThreadCounters
+        {
+            std::atomic<std::uint64_t> allocations { 0 };
+            std::atomic<std::uint64_t> deallocations { 0 };
+            std::atomic<std::uint64_t> sizeHistogram[histogramBuckets] {};
+            std::atomic<std::int64_t> pendingBytes { 0 };      // Not yet moved to liveBytes
+
+            Header* quarantine[quarantineSize] = {};
+            std::size_t quarantineNext = 0;
+
+            std::atomic<bool> inUse { true };
+            ThreadCounters* next = nullptr;
+        };
+
+        inline std::atomic<ThreadCounters*> allCounters { nullptr };
+        inline std::atomic<std::uint64_t> liveBytes { 0 };
+        inline std::atomic<std::uint64_t> peakBytes { 0 };
+        inline std::atomic<std::uint64_t> errors { 0 };
+
+        // Single writer, so no read-modify-write instruction is needed
+        inline void bump(std::atomic<std::uint64_t>& counter) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // Only once a thread's balance passes the batch size does it touch the shared total
+        inline void addLiveBytes(ThreadCounters& counters, std::int64_t delta) noexcept
+        {
+            std::int64_t pending = counters.pendingBytes.load(std::memory_order_relaxed) + delta;
+
+            if (pending < liveBytesBatch && pending > -liveBytesBatch)
+            {
+                counters.pendingBytes.store(pending, std::memory_order_relaxed);
+
+                return;
+            }
+
+            counters.pendingBytes.store(0, std::memory_order_relaxed);
+
+            std::uint64_t live = liveBytes.fetch_add(static_cast<std::uint64_t>(pending), std::memory_order_relaxed) +
+                                 static_cast<std::uint64_t>(pending);
+            std::uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+            while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) { }
+        }
+
+        // Returns the block that falls out of the quarantine, if any, for the caller to free
+        inline Header* quarantineBlock(ThreadCounters& counters, Header* header) noexcept
+        {
+            Header* oldest = counters.quarantine[counters.quarantineNext];
+            counters.quarantine[counters.quarantineNext] = header;
+            counters.quarantineNext = (counters.quarantineNext + 1) % quarantineSize;
+
+            return oldest;
+        }
+
+        inline ThreadCounters* acquireCounters() noexcept
+        {
+            for (ThreadCounters* counters = allCounters.load(std::memory_order_acquire); counters;
+                 counters = counters->next)
+            {
+                bool idle = false;
+
+                if (counters->inUse.compare_exchange_strong(idle, true, std::memory_order_acquire))
+                {
+                    return counters;
+                }
+            }
+
+            // std::malloc, not new: we are inside operator new
+            void* p_memory = std::malloc(sizeof(ThreadCounters));
+
+            if (p_memory == nullptr)
+            {
+                return nullptr;
+            }
+
+            ThreadCounters* counters = new (p_memory) ThreadCounters;
+            counters->next = allCounters.load(std::memory_order_relaxed);
+            while (!allCounters.compare_exchange_weak(counters->next, counters, std::memory_order_release)) { }
+
+            return counters;
+        }
+
+        // Trivially destructible, so it can still be read after the thread's other thread_locals are destroyed
+        inline thread_local bool threadCountersReleased = false;
+
+        inline ThreadCounters* threadCounters() noexcept
+        {
+            struct Holder
+            {
+                ThreadCounters* counters = nullptr;
+
+                ~Holder()
+                {
+                    if (counters)
+                    {
+                        counters->inUse.store(false, std::memory_order_release);
+                        counters = nullptr;
+                    }
+
+                    threadCountersReleased = true;
+                }
+            };
+
+            static thread_local Holder holder;
+
+            if (holder.counters == nullptr)
+            {
+                holder.counters = acquireCounters();
+            }
+
+            return holder.counters;
+        }
+
+        // The counters for one call. Once the thread has released its block (a delete from a later thread_local
+        // destructor), the call borrows a free block and gives it back as soon as it is done.
+        class CountersLease
+        {
+            public:
+                CountersLease() noexcept
+                    : m_borrowed { threadCountersReleased },
+                      m_counters { m_borrowed ? acquireCounters() : threadCounters() } {}
+
+                ~CountersLease()
+                {
+                    if (m_borrowed && m_counters)
+                    {
+                        m_counters->inUse.store(false, std::memory_order_release);
+                    }
+                }
+
+                CountersLease(const CountersLease&) = delete;
+                CountersLease& operator = (const CountersLease&) = delete;
+
+                ThreadCounters* get() const noexcept
+                {
+                    return m_counters;
+                }
+
+
+            private:
+                const bool m_borrowed;
+                ThreadCounters* const m_counters;
+        };
+
+        inline void reportAndAbort(HeapError error, void* p_memory)
+        {
+            static const char* const messages[] = { "double delete", "damaged block header", "buffer overrun" };
+
+            // No iostreams here, they may allocate
+            std::fprintf(stderr, "GuardedHeap: %s at %p\n", messages[static_cast<int>(error)], p_memory);
+            std::abort();
+        }
+
+        inline std::atomic<ErrorHandler> errorHandler { reportAndAbort };
+
+        inline std::size_t bucketFor(std::size_t size) noexcept
+        {
+            // Number of bits needed for size - 1, i.e. the smallest n with size <= 2^n
+            std::size_t bucket = size <= 1 ? 0 : 64 - __builtin_clzll(size - 1);
+
+            return bucket < histogramBuckets ? bucket : histogramBuckets - 1;
+        }
+
+        inline void raise(HeapError error, void* p_memory)
+        {
+            errors.fetch_add(1, std::memory_order_relaxed);
+            errorHandler.load(std::memory_order_relaxed)(error, p_memory);
+        }
+    }
+
+
+    inline bool enabled() noexcept
+    {
+        // A function-local static: operator new may run before any other static of this file is initialized
+        static const bool guarded = std::getenv("GUARDED_HEAP") != nullptr;
+
+        return guarded;
+    }
+
+
+    inline Statistics statistics() noexcept
+    {
+        using namespace Detail;
+
+        Statistics result {
+            0,
+            0,
+            liveBytes.load(std::memory_order_relaxed),
+            peakBytes.load(std::memory_order_relaxed),
+            errors.load(std::memory_order_relaxed),
+            {}
+        };
+
+        for (ThreadCounters* counters = allCounters.load(std::memory_order_acquire); counters;
+             counters = counters->next)
+        {
+            result.allocations += counters->allocations.load(std::memory_order_relaxed);
+            result.deallocations += counters->deallocations.load(std::memory_order_relaxed);
+            result.liveBytes += static_cast<std::uint64_t>(counters->pendingBytes.load(std::memory_order_relaxed));
+
+            for (std::size_t bucket = 0; bucket < histogramBuckets; ++bucket)
+            {
+                result.sizeHistogram[bucket] += counters->sizeHistogram[bucket].load(std::memory_order_relaxed);
+            }
+        }
+
+        result.peakBytes = std::max(result.peakBytes, result.liveBytes);
+
+        return result;
+    }
+
+
+    inline ErrorHandler set_error_handler(ErrorHandler handler) noexcept
+    {
+        return Detail::errorHandler.exchange(handler ? handler : Detail::reportAndAbort);
+    }
+}
+
+
+void* operator new (std::size_t size)
+{
+    using namespace GuardedHeap::Detail;
+
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    const bool guarded = GuardedHeap::enabled();
+
+    if (guarded && size > SIZE_MAX - sizeof(Header) - sizeof(std::uint64_t))
+    {
+        throw std::bad_alloc();     // The header and the tail signature would wrap the size around
+    }
+
+    const std::size_t realSize = guarded ? sizeof(Header) + size + sizeof(std::uint64_t) : size;
+
+    while (true)
+    {
+        void* p_memory = std::malloc(realSize);
+
+        if (p_memory == nullptr)
+        {
+            std::new_handler globalHandler = std::get_new_handler();
+
+            if (globalHandler)
+            {
+                (*globalHandler)();
+                continue;
+            }
+
+            throw std::bad_alloc();
+        }
+
+        if (!guarded)
+        {
+            return p_memory;
+        }
+
+        Header* header = static_cast<Header*>(p_memory);
+        header->size = size;
+        header->signature = liveSignature;
+
+        char* userMemory = reinterpret_cast<char*>(header + 1);
+        std::memcpy(userMemory + size, &liveSignature, sizeof(liveSignature));
+
+        CountersLease lease;
+
+        if (ThreadCounters* counters = lease.get())
+        {
+            bump(counters->allocations);
+            bump(counters->sizeHistogram[bucketFor(size)]);
+            addLiveBytes(*counters, static_cast<std::int64_t>(size));
+        }
+
+        return userMemory;
+    }
+}
+
+
+void operator delete (void* rawMemory) noexcept
+{
+    using namespace GuardedHeap::Detail;
+
+    if (rawMemory == nullptr)
+    {
+        return;
+    }
+
+    if (!GuardedHeap::enabled())
+    {
+        std::free(rawMemory);
+
+        return;
+    }
+
+    Header* header = static_cast<Header*>(rawMemory) - 1;
+
+    if (header->signature != liveSignature)
+    {
+        // Don't touch the memory any further, it is either already freed or not ours
+        raise(header->signature == freedSignature ? GuardedHeap::HeapError::DoubleDelete
+                                                  : GuardedHeap::HeapError::DamagedHeader, rawMemory);
+
+        return;
+    }
+
+    std::uint64_t tail;
+    std::memcpy(&tail, static_cast<char*>(rawMemory) + header->size, sizeof(tail));
+
+    if (tail != liveSignature)
+    {
+        raise(GuardedHeap::HeapError::Overrun, rawMemory);
+    }
+
+    header->signature = freedSignature;
+
+    CountersLease lease;
+
+    if (ThreadCounters* counters = lease.get())
+    {
+        bump(counters->deallocations);
+        addLiveBytes(*counters, -static_cast<std::int64_t>(header->size));
+
+        // Keep the header out of the system allocator's reach for a while, see above
+        header = quarantineBlock(*counters, header);
+    }
+
+    std::free(header);
+}
+
+
+void operator delete (void* rawMemory, std::size_t) noexcept
+{
+    ::operator delete(rawMemory);
+}
+
+
+/**
+ * To measure the overhead, run the same allocation loop twice, once with GUARDED_HEAP set and once without,
+ * and compare the times. What is left is mostly the checks, the extra header and guard bytes, and the quarantine.
+*/
+std::chrono::nanoseconds timeAllocationLoop(std::size_t rounds)
+{
+    constexpr std::size_t batch = 256;
+    void* blocks[batch];
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t round = 0; round < rounds; ++round)
+    {
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            blocks[i] = ::operator new(16 + (i * 37) % 512);
+        }
+
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            ::operator delete(blocks[i]);
+        }
+    }
+
+    return std::chrono::steady_clock::now() - start;
+}
+
+
+
+/**
+ * Reasons 5 and 6: alignment beyond what the default allocator promises, and clustering related objects.
+ *
+ * Since C++17, a new expression for a type whose alignment exceeds __STDCPP_DEFAULT_NEW_ALIGNMENT__ calls
+ * an operator new taking a std::align_val_t, so a class can own over-aligned allocation like any other.
+ *
+ * The arena below hands out memory from 4 KiB pages. Each thread bump-allocates from its own current page,
+ * so objects allocated one after another by a thread sit next to each other, and a cluster hint makes sure
+ * a group of them (say, a Person2 and its Person2Implementation from Item 31) does not straddle two pages.
+ *
+ * Every page starts with a header holding a reference count: one per live object, plus one while the page
+ * is still some thread's current page. operator delete finds the header by rounding the pointer down to
+ * the page boundary, so no per-object header is needed, and the last delete frees the page.
+ * Requests that don't fit in a page, or want page alignment or more, get a run of pages of their own,
+ * with the header in the page just before the object.
+*/
+namespace ClusteredArena
+{
+    constexpr std::size_t cacheLineSize = 64;
+    constexpr std::size_t pageSize = 4096;
+
+    struct alignas(cacheLineSize) PageHeader
+    {
+        std::atomic<std::size_t> references;
+        void* run;          // What to give back to std::free
+    };
+
+    // The page the calling thread currently allocates from
+    struct ThreadPage
+    {
+        PageHeader* page = nullptr;
+        std::size_t offset = pageSize;
+
+        ~ThreadPage();
+    };
+
+    inline thread_local ThreadPage threadPage;
+
+
+    constexpr std::size_t roundUp(std::size_t value, std::size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+
+    // Same loop as every operator new, around std::aligned_alloc
+    inline void* allocateFromSystem(std::size_t alignment, std::size_t size)
+    {
+        while (true)
+        {
+            if (void* memory = std::aligned_alloc(alignment, size))
+            {
+                return memory;
+            }
+
+            std::new_handler globalHandler = std::get_new_handler();
+
+            if (globalHandler)
+            {
+                (*globalHandler)();
+            }
+            else
+            {
+                throw std::bad_alloc();
+            }
+        }
+    }
+
+
+    inline void release(PageHeader* header) noexcept
+    {
+        if (header->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::free(header->run);
+        }
+    }
+
+
+    inline ThreadPage::~ThreadPage()
+    {
+        if (page)
+        {
+            release(page);
+        }
+    }
+
+
+    inline void startPage(ThreadPage& current)
+    {
+        void* memory = allocateFromSystem(pageSize, pageSize);
+
+        if (current.page)
+        {
+            release(current.page);
+        }
+
+        current.page = new (memory) PageHeader { { 1 }, memory };
+        current.offset = sizeof(PageHeader);
+    }
+
+
+    // Too big for a page, or page-aligned: a run of its own, header in the page in front of the object
+    inline void* allocateRun(std::size_t size, std::size_t alignment)
+    {
+        std::size_t lead = alignment > pageSize ? alignment : pageSize;
+        char* run = static_cast<char*>(allocateFromSystem(lead, lead + roundUp(size, pageSize)));
+
+        char* object = run + lead;
+        new (object - pageSize) PageHeader { { 1 }, run };
+
+        return object;
+    }
+
+
+    inline void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t))
+    {
+        if (size == 0)
+        {
+            size = 1;
+        }
+
+        if (alignment >= pageSize || size > pageSize - sizeof(PageHeader))
+        {
+            return allocateRun(size, alignment);
+        }
+
+        ThreadPage& current = threadPage;
+        std::size_t offset = roundUp(current.offset, alignment);
+
+        if (current.page == nullptr || offset + size > pageSize)
+        {
+            startPage(current);
+            offset = roundUp(current.offset, alignment);
+
+            // Alignment padding after the page header can still push a large object past the end
+            if (offset + size > pageSize)
+            {
+                return allocateRun(size, alignment);
+            }
+        }
+
+        current.page->references.fetch_add(1, std::memory_order_relaxed);
+        current.offset = offset + size;
+
+        return reinterpret_cast<char*>(current.page) + offset;
+    }
+
+
+    inline void deallocate(void* p_memory) noexcept
+    {
+        if (p_memory == nullptr)
+        {
+            return;
+        }
+
+        // One byte back, so a page-aligned object finds the header in the page before it
+        std::uintptr_t address = reinterpret_cast<std::uintptr_t>(p_memory) - 1;
+        release(reinterpret_cast<PageHeader*>(address & ~std::uintptr_t { pageSize - 1 }));
+    }
+
+
+    inline void* allocateCacheAligned(std::size_t size)
+    {
+        return allocate(size, cacheLineSize);
+    }
+
+    inline void* allocatePageAligned(std::size_t size)
+    {
+        return allocate(size, pageSize);
+    }
+
+
+    // Promise that the next bytes allocated by this thread land in a single page
+    inline void clusterHint(std::size_t bytes)
+    {
+        ThreadPage& current = threadPage;
+
+        if (current.page == nullptr || roundUp(current.offset, cacheLineSize) + bytes > pageSize)
+        {
+            startPage(current);
+        }
+    }
+}
+
+
+// Derive from this to put a class, and everything derived from it, in the arena. As Item 52 says, declaring
+// the normal forms hides the placement and nothrow ones, so those are declared here too.
+class ClusterAllocated
+{
+    public:
+        static void* operator new (std::size_t size)
+        {
+            return ClusteredArena::allocate(size);
+        }
+
+        static void* operator new (std::size_t size, std::align_val_t alignment)
+        {
+            return ClusteredArena::allocate(size, static_cast<std::size_t>(alignment));
+        }
+
+        static void operator delete (void* p_memory) noexcept
+        {
+            ClusteredArena::deallocate(p_memory);
+        }
+
+        static void operator delete (void* p_memory, std::align_val_t) noexcept
+        {
+            ClusteredArena::deallocate(p_memory);
+        }
+
+
+        // The arena's memory, so the normal operator delete above frees it
+        static void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+        {
+            try
+            {
+                return ClusteredArena::allocate(size);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return nullptr;
+            }
+        }
+
+        static void operator delete (void* p_memory, const std::nothrow_t&) noexcept
+        {
+            ClusteredArena::deallocate(p_memory);
+        }
+
+
+        // Constructs in memory the caller owns, the arena is not involved
+        static void* operator new (std::size_t size, void* p_memory) noexcept
+        {
+            return ::operator new(size, p_memory);
+        }
+
+        static void operator delete (void* p_memory, void* p_place) noexcept
+        {
+            ::operator delete(p_memory, p_place);
+        }
+};
+
+
+// Person2 and Person2Implementation from Item 31, with their memory from the arena
+class Date { };
+
+class Person2Implementation : public ClusterAllocated
+{
+    public:
+        Person2Implementation(std::string_view name, std::string_view address, const Date& date)
+            : m_name { name }, m_address { address }, m_birthday { date } {}
+
+        std::string m_name;
+        std::string m_address;
+        Date m_birthday;
+};
+
+class Person2 : public ClusterAllocated
+{
+    public:
+        Person2(std::string_view name, std::string_view address, const Date& date)
+            : m_p_implementation { new Person2Implementation(name, address, date) } {}
+
+        ~Person2()
+        {
+            delete m_p_implementation;
+        }
+
+        Person2(const Person2&) = delete;
+        Person2& operator = (const Person2&) = delete;
+
+
+    private:
+        Person2Implementation* m_p_implementation;
+};
+
+// The handle and its implementation share a page, so following the pimpl pointer stays close by
+Person2* makePerson(const std::string& name, const std::string& address, const Date& date)
+{
+    ClusteredArena::clusterHint(sizeof(Person2) + sizeof(Person2Implementation));
+
+    return new Person2(name, address, date);
+}
+
+// A cache-line-aligned type goes through the align_val_t overload, so counters in it never share a line
+struct alignas(ClusteredArena::cacheLineSize) HitCounter : ClusterAllocated
+{
+    std::atomic<long> hits;
+};
+
+void useArena()
+{
+    Person2* p_person = makePerson("Ada", "London", Date());
+    HitCounter* p_counter = new HitCounter;
+
+    delete p_counter;
+    delete p_person;
+}
+
+
+/**
+ * A pointer-chasing walk shows the effect. Each node points to a payload allocated right after it,
+ * with unrelated allocations in between, as happens in a real program. From the global heap, a node and
+ * its payload end up far apart; from the arena, the unrelated allocations go elsewhere and the pair shares
+ * a cache line or two. Fewer lines touched per hop means fewer cache misses, which shows up directly as a
+ * shorter walk (or count them with "perf stat -e cache-misses").
+*/
+struct GlobalHeapAllocated { };
+
+inline volatile long pointerChaseResult = 0;   // Stored once per walk, keeps the walk from being optimized away
+
+template <typename Base>
+std::chrono::nanoseconds timePointerChase(std::size_t nodeCount)
+{
+    struct Payload : Base
+    {
+        long value;
+    };
+
+    struct Node : Base
+    {
+        Node* next;
+        Payload* payload;
+    };
+
+    std::vector<void*> unrelated;
+    Node* head = nullptr;
+
+    for (std::size_t i = 0; i < nodeCount; ++i)
+    {
+        if constexpr (std::is_same_v<Base, ClusterAllocated>)
+        {
+            ClusteredArena::clusterHint(sizeof(Node) + sizeof(Payload));
+        }
+
+        Node* node = new Node;
+        unrelated.push_back(::operator new(48 + i % 200));      // Noise from the rest of the program
+        node->payload = new Payload;
+        node->payload->value = static_cast<long>(i);
+        node->next = head;
+        head = node;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    long sum = 0;
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        for (Node* node = head; node; node = node->next)
+        {
+            sum += node->payload->value;
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    pointerChaseResult = sum;
+
+    while (head)
+    {
+        Node* next = head->next;
+        delete head->payload;
+        delete head;
+        head = next;
+    }
+
+    for (void* p : unrelated)
+    {
+        ::operator delete(p);
+    }
+
+    return elapsed;
+}
+
+struct ChaseTimes
+{
+    std::chrono::nanoseconds heap;
+    std::chrono::nanoseconds arena;
+};
+
+ChaseTimes comparePointerChase(std::size_t nodeCount = 1'000'000)
+{
+    return { timePointerChase<GlobalHeapAllocated>(nodeCount), timePointerChase<ClusterAllocated>(nodeCount) };
+}
@@ -1,5 +1,13 @@
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <memory_resource>
 #include <new>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
 /**
  * Adhere to convention when writing new and delete.
  *
@@ -25,38 +33,7 @@
  * “while (true)” is about as infinite as it gets. The only way out of the loop is for memory to be successfully
  * allocated or for the new-handling function to do one of the things described in Item 49.
 */
-// Pseudo-code
-void* operator new (std::size_t size) throw(std::bad_alloc)
-{
-    // Handle 0-byte requests by treating them as 1-byte requests
-    if (size == 0)
-    {
-        size = 1;
-    }
-
-    while (true)
-    {
-        /* Attempt to allocate size bytes */
-
-        if (/* The allocation is unsuccessful */)
-        {
-            return /* A pointer to the memory */
-        }
-
-        // Allocation was unsuccessful. Find out what the current new-handling function is
-        std::new_handler globalHandler = std::set_new_handler(0);
-        std::set_new_handler(globalHandler);
-
-        if (globalHandler)
-        {
-            (*globalHandler)();
-        }
-        else
-        {
-            throw std::bad_alloc();
-        }
-    }
-}
+// The pseudo-code, made real, is the replacement global operator new in SizeClassAllocator below
 
 
 /**
@@ -121,16 +98,7 @@ void* Base::operator new (std::size_t size) throw(std::bad_alloc)
  * All you need to remember for operator delete is that C++ guarantees it’s always safe to delete the null pointer,
  * so you need to honor that guarantee.
 */
-void operator delete(void* rawMemory) throw()
-{
-    if (rawMemory == 0)
-    {
-        // Do nothing if the null pointer is being deleted
-        return;
-    }
-
-    /* Deallocate the memory pointed to by rawMemory */
-}
+// The replacement global operator delete in SizeClassAllocator below does exactly that
 
 
 class Base2
@@ -155,4 +123,517 @@ void Base2::operator delete (void *rawMemory, std::size_t size) throw()
 
         return;
     }
-}
\ No newline at end of file
+}
+
+
+/**
+ * The pseudo-code operator new and operator delete above leave the actual allocation as a comment.
+ * A real replacement that is worth the trouble (Item 50) usually looks like this:
+ *
+ * 1. Requests are rounded up to a small number of size classes, and each class keeps a free list of blocks.
+ *
+ * 2. Each thread has its own cache of free lists, so the common case pops or pushes a block without any lock.
+ *
+ * 3. When a thread cache runs dry, it takes a whole batch of blocks from a central heap under a lock,
+ *    and when it holds too many, it gives a batch back. The lock is paid once per batch, not once per call.
+ *
+ * 4. Memory comes from std::malloc (operator new can't call itself), wrapped in the same loop as the pseudo-code:
+ *    retry while a new-handler is installed, throw bad_alloc when there is none.
+ *
+ * Every block starts with a small header that records its size class, because the unsized operator delete
+ * has nothing else to go on. Requests larger than the biggest class go straight to std::malloc.
+ * Chunks carved into blocks are never handed back to the system.
+*/
+namespace SizeClassAllocator
+{
+    constexpr std::size_t headerSize = alignof(std::max_align_t);           // Keeps the returned pointer aligned
+    constexpr std::size_t classGranularity = alignof(std::max_align_t);
+    constexpr std::size_t classCount = 16;                                 // Classes of 16, 32, ..., 256 bytes
+    constexpr std::size_t largeClass = classCount;                         // Marks blocks from std::malloc
+    constexpr std::size_t batchSize = 32;                                  // Blocks moved to or from the central heap at once
+    constexpr std::size_t blocksPerChunk = 128;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct CentralList
+    {
+        std::mutex mutex;
+        FreeBlock* head = nullptr;
+    };
+
+    struct ThreadCache
+    {
+        FreeBlock* heads[classCount] = {};
+        std::size_t counts[classCount] = {};
+
+        ~ThreadCache();     // Give the cached blocks back to the central heap when the thread exits
+    };
+
+    // std::mutex has a constexpr constructor, so the central heap is ready before any dynamic initialization runs
+    inline CentralList centralLists[classCount];
+    inline thread_local ThreadCache threadCache;
+
+    /**
+     * Destructors of other thread_local objects may still allocate and free after threadCache is gone.
+     * A plain bool has no destructor, so it stays readable until the thread is really finished, and once it is set
+     * those late calls go straight to the central heap.
+    */
+    inline thread_local bool threadCacheDestroyed = false;
+
+
+    constexpr std::size_t blockSize(std::size_t sizeClass)
+    {
+        return headerSize + (sizeClass + 1) * classGranularity;
+    }
+
+
+    // The loop of the pseudo-code operator new, around the system allocator
+    inline void* allocateFromSystem(std::size_t size)
+    {
+        while (true)
+        {
+            if (void* memory = std::malloc(size))
+            {
+                return memory;
+            }
+
+            // Since C++11, std::get_new_handler reads the handler without the set_new_handler(0) dance
+            std::new_handler globalHandler = std::get_new_handler();
+
+            if (globalHandler)
+            {
+                (*globalHandler)();
+            }
+            else
+            {
+                throw std::bad_alloc();
+            }
+        }
+    }
+
+
+    inline void pushBlock(ThreadCache& cache, std::size_t sizeClass, FreeBlock* block) noexcept
+    {
+        block->next = cache.heads[sizeClass];
+        cache.heads[sizeClass] = block;
+        ++cache.counts[sizeClass];
+    }
+
+
+    // Slow path, taken once per batch: borrow blocks from the central heap, or carve a new chunk
+    inline void refill(ThreadCache& cache, std::size_t sizeClass)
+    {
+        {
+            CentralList& central = centralLists[sizeClass];
+            std::lock_guard<std::mutex> guard(central.mutex);
+
+            for (std::size_t i = 0; i < batchSize && central.head; ++i)
+            {
+                FreeBlock* block = central.head;
+                central.head = block->next;
+                pushBlock(cache, sizeClass, block);
+            }
+        }
+
+        if (cache.heads[sizeClass])
+        {
+            return;
+        }
+
+        // The lock is released first, the new-handler may well want to free memory itself
+        char* chunk = static_cast<char*>(allocateFromSystem(blockSize(sizeClass) * blocksPerChunk));
+
+        for (std::size_t i = 0; i < blocksPerChunk; ++i)
+        {
+            pushBlock(cache, sizeClass, reinterpret_cast<FreeBlock*>(chunk + i * blockSize(sizeClass)));
+        }
+    }
+
+
+    // Move up to count blocks of one class from a thread cache to the central heap
+    inline void flush(ThreadCache& cache, std::size_t sizeClass, std::size_t count) noexcept
+    {
+        CentralList& central = centralLists[sizeClass];
+        std::lock_guard<std::mutex> guard(central.mutex);
+
+        for (std::size_t i = 0; i < count && cache.heads[sizeClass]; ++i)
+        {
+            FreeBlock* block = cache.heads[sizeClass];
+            cache.heads[sizeClass] = block->next;
+            --cache.counts[sizeClass];
+
+            block->next = central.head;
+            central.head = block;
+        }
+    }
+
+
+    inline ThreadCache::~ThreadCache()
+    {
+        for (std::size_t sizeClass = 0; sizeClass < classCount; ++sizeClass)
+        {
+            flush(*this, sizeClass, counts[sizeClass]);
+        }
+
+        threadCacheDestroyed = true;
+    }
+
+
+    // Used after the thread cache is destroyed: one block at a time, under the central lock
+    inline FreeBlock* allocateCentral(std::size_t sizeClass)
+    {
+        CentralList& central = centralLists[sizeClass];
+
+        {
+            std::lock_guard<std::mutex> guard(central.mutex);
+
+            if (FreeBlock* block = central.head)
+            {
+                central.head = block->next;
+
+                return block;
+            }
+        }
+
+        char* chunk = static_cast<char*>(allocateFromSystem(blockSize(sizeClass) * blocksPerChunk));
+        std::lock_guard<std::mutex> guard(central.mutex);
+
+        for (std::size_t i = 1; i < blocksPerChunk; ++i)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize(sizeClass));
+            block->next = central.head;
+            central.head = block;
+        }
+
+        return reinterpret_cast<FreeBlock*>(chunk);
+    }
+
+    inline void freeCentral(std::size_t sizeClass, FreeBlock* block) noexcept
+    {
+        CentralList& central = centralLists[sizeClass];
+        std::lock_guard<std::mutex> guard(central.mutex);
+
+        block->next = central.head;
+        central.head = block;
+    }
+}
+
+
+void* operator new (std::size_t size)
+{
+    using namespace SizeClassAllocator;
+
+    // Handle 0-byte requests by treating them as 1-byte requests
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    if (size > classCount * classGranularity)
+    {
+        if (size > SIZE_MAX - headerSize)
+        {
+            throw std::bad_alloc();     // The header would wrap the size around
+        }
+
+        char* block = static_cast<char*>(allocateFromSystem(headerSize + size));
+        *reinterpret_cast<std::size_t*>(block) = largeClass;
+
+        return block + headerSize;
+    }
+
+    std::size_t sizeClass = (size - 1) / classGranularity;
+
+    if (threadCacheDestroyed)
+    {
+        FreeBlock* block = allocateCentral(sizeClass);
+        *reinterpret_cast<std::size_t*>(block) = sizeClass;
+
+        return reinterpret_cast<char*>(block) + headerSize;
+    }
+
+    ThreadCache& cache = threadCache;
+
+    if (cache.heads[sizeClass] == nullptr)
+    {
+        refill(cache, sizeClass);
+    }
+
+    // Fast path, no lock and no system call
+    FreeBlock* block = cache.heads[sizeClass];
+    cache.heads[sizeClass] = block->next;
+    --cache.counts[sizeClass];
+
+    *reinterpret_cast<std::size_t*>(block) = sizeClass;
+
+    return reinterpret_cast<char*>(block) + headerSize;
+}
+
+
+void operator delete (void* rawMemory) noexcept
+{
+    using namespace SizeClassAllocator;
+
+    if (rawMemory == 0)
+    {
+        return;
+    }
+
+    char* block = static_cast<char*>(rawMemory) - headerSize;
+    std::size_t sizeClass = *reinterpret_cast<std::size_t*>(block);
+
+    if (sizeClass == largeClass)
+    {
+        std::free(block);
+
+        return;
+    }
+
+    if (threadCacheDestroyed)
+    {
+        freeCentral(sizeClass, reinterpret_cast<FreeBlock*>(block));
+
+        return;
+    }
+
+    ThreadCache& cache = threadCache;
+    pushBlock(cache, sizeClass, reinterpret_cast<FreeBlock*>(block));
+
+    // Don't let one thread hoard blocks that another thread keeps allocating
+    if (cache.counts[sizeClass] > 2 * batchSize)
+    {
+        flush(cache, sizeClass, batchSize);
+    }
+}
+
+
+// The size is already in the header, so the sized form only has to be declared to keep it out of the default heap
+void operator delete (void* rawMemory, std::size_t) noexcept
+{
+    ::operator delete(rawMemory);
+}
+
+
+/**
+ * The default array and nothrow forms forward to the functions above, so nothing else needs replacing.
+ *
+ * To see whether the replacement pays off, churn allocations of mixed sizes on several threads and compare
+ * allocations per second and peak resident set size with and without it.
+*/
+struct ChurnResult
+{
+    double allocationsPerSecond;
+    long peakResidentKilobytes;
+};
+
+ChurnResult benchmarkChurn(unsigned threadCount, std::size_t allocationsPerThread)
+{
+    auto churn = [allocationsPerThread](unsigned seed)
+    {
+        constexpr std::size_t window = 256;     // Objects kept alive at a time
+        void* live[window] = {};
+
+        for (std::size_t i = 0; i < allocationsPerThread; ++i)
+        {
+            seed = seed * 1103515245u + 12345u;
+            std::size_t slot = seed % window;
+
+            ::operator delete(live[slot]);
+            live[slot] = ::operator new(8 + (seed >> 8) % 256);
+        }
+
+        for (void* p : live)
+        {
+            ::operator delete(p);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back(churn, t + 1);
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return { threadCount * allocationsPerThread / elapsed.count(), usage.ru_maxrss };
+}
+
+
+
+/**
+ * Base::operator new sends every Derived to ::operator new, because it was written for sizeof(Base) only.
+ * A memory resource that keeps one free list per size class serves the whole hierarchy instead:
+ * a Derived just lands in a bigger class.
+ *
+ * Deriving from std::pmr::memory_resource keeps it usable by std::pmr containers as well. Blocks are carved out
+ * of a std::pmr::monotonic_buffer_resource, so release() returns every chunk at once. That suits request-scoped
+ * lifetimes, where everything allocated while serving a request dies with it. All objects must already be
+ * destroyed when release() is called, it frees memory, it runs no destructors.
+ *
+ * std::pmr::unsynchronized_pool_resource is close, but its deallocate has to search for the chunk a pointer came
+ * from. Here the size passed to the sized operator delete picks the free list directly, and the block needs
+ * no header. Like unsynchronized_pool_resource, it is for one thread at a time.
+*/
+class HierarchyPoolResource : public std::pmr::memory_resource
+{
+    public:
+        explicit HierarchyPoolResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+            : m_chunks { upstream } {}
+
+        HierarchyPoolResource(const HierarchyPoolResource&) = delete;
+        HierarchyPoolResource& operator = (const HierarchyPoolResource&) = delete;
+
+        // Give back all memory at once, every block handed out becomes invalid
+        void release()
+        {
+            for (FreeBlock*& list : m_freeLists)
+            {
+                list = nullptr;
+            }
+
+            m_chunks.release();
+        }
+
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock* next;
+        };
+
+        static constexpr std::size_t granularity = alignof(std::max_align_t);
+        static constexpr std::size_t classCount = 32;      // Free lists for 16, 32, ..., 512 bytes
+
+        // Larger or over-aligned blocks are not pooled, their memory comes back with release()
+        static bool pooled(std::size_t bytes, std::size_t alignment)
+        {
+            return bytes <= classCount * granularity && alignment <= granularity;
+        }
+
+        static std::size_t sizeClass(std::size_t bytes)
+        {
+            return bytes == 0 ? 0 : (bytes - 1) / granularity;
+        }
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            if (!pooled(bytes, alignment))
+            {
+                return m_chunks.allocate(bytes, alignment);
+            }
+
+            std::size_t index = sizeClass(bytes);
+
+            if (FreeBlock* block = m_freeLists[index])
+            {
+                m_freeLists[index] = block->next;
+
+                return block;
+            }
+
+            return m_chunks.allocate((index + 1) * granularity, granularity);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+        {
+            if (!pooled(bytes, alignment))
+            {
+                return;
+            }
+
+            FreeBlock* block = static_cast<FreeBlock*>(p);
+            std::size_t index = sizeClass(bytes);
+            block->next = m_freeLists[index];
+            m_freeLists[index] = block;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        FreeBlock* m_freeLists[classCount] = {};
+        std::pmr::monotonic_buffer_resource m_chunks;
+};
+
+
+/**
+ * Base3 sends its whole hierarchy to a HierarchyPoolResource. The size operator delete receives is what routes a
+ * block back to its free list, so the destructor must be virtual: deleting a Derived3 through a Base3* then passes
+ * sizeof(Derived3), not sizeof(Base3). Base2 above stays as the book wrote it, the size check it illustrates is
+ * exactly what Base3 no longer needs.
+ *
+ * The resource can't be looked up from the block, so there is one per thread, and the rules are those of the
+ * resource itself:
+ *
+ * 1. An object is deleted on the thread that created it. The free lists are unsynchronized.
+ *
+ * 2. An object is deleted before its thread exits, and before the thread calls releaseArena(). Both end the
+ *    arena's memory at once, and with it every object still in it.
+*/
+class Base3
+{
+    public:
+        virtual ~Base3() = default;
+
+        static void* operator new (std::size_t size)
+        {
+            return arena().allocate(size, alignof(std::max_align_t));
+        }
+
+        static void operator delete (void* rawMemory, std::size_t size) noexcept
+        {
+            if (rawMemory == 0)
+            {
+                return;
+            }
+
+            arena().deallocate(rawMemory, size, alignof(std::max_align_t));
+        }
+
+        // End of a request: every Base3 the thread allocated must already be deleted
+        static void releaseArena()
+        {
+            arena().release();
+        }
+
+
+    private:
+        static HierarchyPoolResource& arena()
+        {
+            static thread_local HierarchyPoolResource resource { std::pmr::new_delete_resource() };
+
+            return resource;
+        }
+};
+
+
+class Derived3 : public Base3
+{
+    private:
+        double m_extra[4];      // Bigger than Base3, still pooled
+};
+
+
+void handleRequest()
+{
+    Base3* p_base = new Derived3;       // Served from the 48-byte free list, not ::operator new
+    delete p_base;                      // Back to the same free list, found from the size alone
+
+    // Anything allocated and destroyed while serving the request is returned here in one step
+    Base3::releaseArena();
+}
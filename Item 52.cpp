@@ -1,5 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <new>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 /**
  * Write placement delete if you write placement new.
  *
@@ -106,4 +116,485 @@ class StandardNewDeleteForms
 
         static void operator delete(void *pMemory, const std::nothrow_t&) throw()
         { ::operator delete(pMemory); }
-};
\ No newline at end of file
+};
+
+
+
+/**
+ * Example::operator new(std::size_t, std::ostream&) formats and writes to a stream inside every allocation,
+ * which is far too slow for a hot path. A cheaper way to trace allocations:
+ *
+ * 1. Each allocation or deallocation becomes a fixed-size binary record, no formatting at all.
+ *
+ * 2. Records go into a ring buffer owned by the allocating thread. Only that thread writes to it and only the
+ *    drain thread reads from it, so two atomic indices are all the synchronization needed.
+ *    When a ring is full the record is dropped and counted, the allocating thread never waits.
+ *
+ * 3. A background thread drains every ring into a file. Turning the records into a report is left to an
+ *    offline tool, see reportTrace below.
+ *
+ * The call site is recorded as the return address of operator new (resolve it with addr2line), or as a tag passed
+ * through a placement form, just like the ostream above. As this Item requires, the placement new comes with
+ * a matching placement delete.
+*/
+enum class TraceKind : std::uint32_t
+{
+    Allocate,
+    Deallocate,
+    Dropped         // Written by AllocationTracer::stop for each kind, see droppedRecord
+};
+
+struct TraceRecord
+{
+    std::uint64_t timestamp;    // steady_clock ticks
+    std::uint64_t address;
+    std::uint64_t site;         // Return address or AllocationSite tag, 0 for deallocations
+    std::uint32_t size;
+    TraceKind kind;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "Records are written to the trace file as they are");
+
+
+// How many records of one kind were lost: the 64-bit count goes in address, the kind lost in site
+inline TraceRecord droppedRecord(TraceKind lost, std::uint64_t count) noexcept
+{
+    return { 0, count, static_cast<std::uint64_t>(lost), 0, TraceKind::Dropped };
+}
+
+
+// Single producer (the owning thread), single consumer (the drain thread)
+class TraceRing
+{
+    public:
+        bool push(const TraceRecord& record) noexcept
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head - m_tail.load(std::memory_order_acquire) == capacity)
+            {
+                return false;
+            }
+
+            m_records[head % capacity] = record;
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Write everything published so far, in at most two contiguous pieces
+        void drainTo(std::FILE* file) noexcept
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            std::size_t head = m_head.load(std::memory_order_acquire);
+
+            while (tail != head)
+            {
+                std::size_t count = std::min(head - tail, capacity - tail % capacity);
+                std::fwrite(&m_records[tail % capacity], sizeof(TraceRecord), count, file);
+                tail += count;
+            }
+
+            m_tail.store(tail, std::memory_order_release);
+        }
+
+        std::atomic<bool> retired { false };     // Set when the owning thread exits
+
+
+    private:
+        static constexpr std::size_t capacity = 4096;
+
+        TraceRecord m_records[capacity];
+        alignas(64) std::atomic<std::size_t> m_head { 0 };     // Next slot to write, producer only
+        alignas(64) std::atomic<std::size_t> m_tail { 0 };     // Next slot to read, consumer only
+};
+
+
+class AllocationTracer
+{
+    public:
+        static void start(const char* path);
+        static void stop();
+
+        static void record(TraceKind kind, void* address, std::size_t size, std::uintptr_t site) noexcept;
+
+
+    private:
+        static TraceRing* threadRing();
+        static void drainAll();
+
+        static inline std::mutex registryMutex;             // Taken once per thread, and by the drain thread
+        static inline std::vector<TraceRing*> rings;
+        static inline std::atomic<bool> running { false };
+        static inline std::atomic<std::uint64_t> dropped[2] {};      // Indexed by TraceKind::Allocate, Deallocate
+        static inline std::FILE* file = nullptr;
+        static inline std::thread drainer;
+};
+
+
+void AllocationTracer::record(TraceKind kind, void* address, std::size_t size, std::uintptr_t site) noexcept
+{
+    if (!running.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    TraceRecord record {
+        static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()),
+        reinterpret_cast<std::uintptr_t>(address),
+        site,
+        static_cast<std::uint32_t>(size),
+        kind
+    };
+
+    TraceRing* ring = threadRing();
+
+    if (ring == nullptr || !ring->push(record))
+    {
+        dropped[static_cast<std::size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+TraceRing* AllocationTracer::threadRing()
+{
+    // Trivially destructible, so a record from a later thread_local destructor can still read it
+    static thread_local bool ringReleased = false;
+
+    // The ring outlives its thread, the drain thread frees it once it has read the last record
+    struct RingHolder
+    {
+        TraceRing* ring = nullptr;
+
+        ~RingHolder()
+        {
+            if (ring)
+            {
+                ring->retired.store(true, std::memory_order_release);
+                ring = nullptr;
+            }
+
+            ringReleased = true;
+        }
+    };
+
+    if (ringReleased)
+    {
+        return nullptr;     // The ring may be gone already, the record is counted as dropped
+    }
+
+    static thread_local RingHolder holder;
+
+    if (holder.ring == nullptr)
+    {
+        TraceRing* ring = new (std::nothrow) TraceRing;
+
+        if (ring == nullptr)
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> guard(registryMutex);
+        rings.push_back(ring);
+        holder.ring = ring;
+    }
+
+    return holder.ring;
+}
+
+
+/**
+ * Only the registry is read under the lock; the file is written after releasing it, so a thread registering its
+ * first ring never waits on I/O. Reading a ring needs no lock, and only this function deletes rings, so the
+ * pointers stay valid after unlocking.
+*/
+void AllocationTracer::drainAll()
+{
+    std::vector<std::pair<TraceRing*, bool>> snapshot;
+
+    {
+        std::lock_guard<std::mutex> guard(registryMutex);
+        snapshot.reserve(rings.size());
+
+        for (auto it = rings.begin(); it != rings.end(); )
+        {
+            // Check retired before draining, so no record pushed before the thread exited is lost
+            bool retired = (*it)->retired.load(std::memory_order_acquire);
+            snapshot.emplace_back(*it, retired);
+
+            it = retired ? rings.erase(it) : it + 1;
+        }
+    }
+
+    for (auto [ring, retired] : snapshot)
+    {
+        ring->drainTo(file);
+
+        if (retired)
+        {
+            delete ring;
+        }
+    }
+}
+
+
+void AllocationTracer::start(const char* path)
+{
+    if (running.exchange(true))
+    {
+        return;     // Already tracing, and drainer is still joinable
+    }
+
+    file = std::fopen(path, "wb");
+
+    if (file == nullptr)
+    {
+        running.store(false);
+
+        return;
+    }
+
+    drainer = std::thread([]
+    {
+        while (running.load(std::memory_order_relaxed))
+        {
+            drainAll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+}
+
+
+void AllocationTracer::stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+
+    drainer.join();
+    drainAll();
+
+    for (TraceKind kind : { TraceKind::Allocate, TraceKind::Deallocate })
+    {
+        TraceRecord lost = droppedRecord(kind, dropped[static_cast<std::size_t>(kind)].exchange(0));
+        std::fwrite(&lost, sizeof(lost), 1, file);
+    }
+    std::fclose(file);
+    file = nullptr;
+}
+
+
+// Tag for the placement form, plays the role the ostream played in Example
+struct AllocationSite
+{
+    std::uint32_t id;
+};
+
+
+/**
+ * Built on StandardNewDeleteForms, so the forms it does not trace stay available to clients.
+ * The normal and nothrow forms are traced, and the placement form taking an AllocationSite replaces
+ * the ostream version, with its matching placement delete.
+*/
+class TracedNewDeleteForms : public StandardNewDeleteForms
+{
+    public:
+        using StandardNewDeleteForms::operator new;
+        using StandardNewDeleteForms::operator delete;
+
+        // Never inlined, otherwise the return address would be the caller's caller
+        __attribute__((noinline)) static void* operator new(std::size_t size)
+        {
+            void* memory = ::operator new(size);
+            AllocationTracer::record(TraceKind::Allocate, memory, size,
+                                     reinterpret_cast<std::uintptr_t>(__builtin_return_address(0)));
+
+            return memory;
+        }
+
+        static void operator delete(void* pMemory) noexcept
+        {
+            if (pMemory)
+            {
+                AllocationTracer::record(TraceKind::Deallocate, pMemory, 0, 0);
+            }
+
+            ::operator delete(pMemory);
+        }
+
+
+        __attribute__((noinline)) static void* operator new(std::size_t size, const std::nothrow_t& nt) noexcept
+        {
+            void* memory = ::operator new(size, nt);
+
+            if (memory)
+            {
+                AllocationTracer::record(TraceKind::Allocate, memory, size,
+                                         reinterpret_cast<std::uintptr_t>(__builtin_return_address(0)));
+            }
+
+            return memory;
+        }
+
+        static void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+        {
+            operator delete(pMemory);
+        }
+
+
+        static void* operator new(std::size_t size, AllocationSite site)
+        {
+            void* memory = ::operator new(size);
+            AllocationTracer::record(TraceKind::Allocate, memory, size, site.id);
+
+            return memory;
+        }
+
+        static void operator delete(void* pMemory, AllocationSite) noexcept
+        {
+            operator delete(pMemory);
+        }
+};
+
+
+class Example3 : public TracedNewDeleteForms { /*...*/ };
+
+Example3 *p_example3 = new Example3;                        // Traced, site is the caller's return address
+Example3 *p_example4 = new (AllocationSite { 42 }) Example3;  // Traced, site is 42
+
+
+/**
+ * The offline half: replay a trace file and report leaks, a size histogram, and the sites doing the most allocating.
+ * Blocks still live when the trace ends are reported as leaks, so stop the tracer as late as possible.
+ * Every dropped deallocation leaves a block looking live, so the leak count is reported together with how many
+ * of those leaks may be false; dropped allocations only mean some deallocations match nothing.
+*/
+void reportTrace(const char* path, std::ostream& out)
+{
+    struct Live
+    {
+        std::uint32_t size;
+        std::uint64_t site;
+    };
+
+    struct SiteStatistics
+    {
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t leakedBlocks = 0;
+        std::uint64_t leakedBytes = 0;
+    };
+
+    std::FILE* file = std::fopen(path, "rb");
+
+    if (file == nullptr)
+    {
+        out << "Cannot open " << path << '\n';
+
+        return;
+    }
+
+    std::unordered_map<std::uint64_t, Live> live;
+    std::unordered_map<std::uint64_t, SiteStatistics> sites;
+    std::uint64_t histogram[33] = {};    // Bucket n counts sizes in (2^(n-1), 2^n]
+    std::uint64_t droppedAllocations = 0;
+    std::uint64_t droppedDeallocations = 0;
+
+    TraceRecord records[1024];
+    std::size_t count;
+
+    while ((count = std::fread(records, sizeof(TraceRecord), 1024, file)) > 0)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const TraceRecord& record = records[i];
+
+            switch (record.kind)
+            {
+                case TraceKind::Allocate:
+                {
+                    live[record.address] = { record.size, record.site };
+
+                    SiteStatistics& site = sites[record.site];
+                    ++site.allocations;
+                    site.bytes += record.size;
+
+                    std::size_t bucket = 0;
+                    while (bucket < 32 && (std::uint64_t { 1 } << bucket) < record.size)
+                    {
+                        ++bucket;
+                    }
+                    ++histogram[bucket];
+
+                    break;
+                }
+
+                case TraceKind::Deallocate:
+                    live.erase(record.address);
+                    break;
+
+                case TraceKind::Dropped:
+                    if (static_cast<TraceKind>(record.site) == TraceKind::Deallocate)
+                    {
+                        droppedDeallocations += record.address;
+                    }
+                    else
+                    {
+                        droppedAllocations += record.address;
+                    }
+                    break;
+            }
+        }
+    }
+
+    std::fclose(file);
+
+    for (const auto& [address, block] : live)
+    {
+        SiteStatistics& site = sites[block.site];
+        ++site.leakedBlocks;
+        site.leakedBytes += block.size;
+    }
+
+    std::vector<std::pair<std::uint64_t, SiteStatistics>> ranked(sites.begin(), sites.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& lhs, const auto& rhs)
+    {
+        return lhs.second.allocations > rhs.second.allocations;
+    });
+
+    out << "Records dropped: " << droppedAllocations << " allocations, " << droppedDeallocations << " deallocations\n\n"
+        << "Leaks: " << live.size() << " blocks";
+
+    if (droppedDeallocations)
+    {
+        out << ", up to " << std::min<std::uint64_t>(droppedDeallocations, live.size())
+            << " of them false, their deallocation records were dropped";
+    }
+
+    out << '\n';
+    for (const auto& [site, statistics] : ranked)
+    {
+        if (statistics.leakedBlocks)
+        {
+            out << "  site 0x" << std::hex << site << std::dec << ": " << statistics.leakedBlocks
+                << " blocks, " << statistics.leakedBytes << " bytes\n";
+        }
+    }
+
+    out << "\nSize histogram:\n";
+    for (std::size_t bucket = 0; bucket < 33; ++bucket)
+    {
+        if (histogram[bucket])
+        {
+            out << "  <= " << (std::uint64_t { 1 } << bucket) << " bytes: " << histogram[bucket] << '\n';
+        }
+    }
+
+    out << "\nHot sites:\n";
+    for (std::size_t i = 0; i < ranked.size() && i < 10; ++i)
+    {
+        out << "  site 0x" << std::hex << ranked[i].first << std::dec << ": " << ranked[i].second.allocations
+            << " allocations, " << ranked[i].second.bytes << " bytes\n";
+    }
+}